@@ -1,10 +1,16 @@
 #include <ctype.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
 #include "panel.h"
 #include "dialog.h"
+#include "glyph.h"
 #include "lcd.h"
 
 #define max(a,b) \
@@ -17,21 +23,203 @@
 	  __typeof__ (b) _b = (b); \
 	  _a < _b ? _a : _b; })
 
+enum {
+	ARROW_LEFT,
+	ARROW_RIGHT,
+	ARROW_UP,
+	ARROW_DOWN,
+	ARROW_UPDOWN,
+	ARROW_COUNT,
+};
+
+static const glyph_t arrows[ARROW_COUNT] = {
+	[ARROW_LEFT] = {{
+		0b00000010,
+		0b00000110,
+		0b00001110,
+		0b00011110,
+		0b00001110,
+		0b00000110,
+		0b00000010,
+		0b00000000,
+	}},
+	[ARROW_RIGHT] = {{
+		0b00001000,
+		0b00001100,
+		0b00001110,
+		0b00001111,
+		0b00001110,
+		0b00001100,
+		0b00001000,
+		0b00000000,
+	}},
+	[ARROW_UP] = {{
+		0b00000100,
+		0b00001110,
+		0b00011111,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+	}},
+	[ARROW_DOWN] = {{
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00011111,
+		0b00001110,
+		0b00000100,
+		0b00000000,
+	}},
+	[ARROW_UPDOWN] = {{
+		0b00000100,
+		0b00001110,
+		0b00011111,
+		0b00000000,
+		0b00011111,
+		0b00001110,
+		0b00000100,
+		0b00000000,
+	}},
+};
+
+/* CGRAM character codes for arrows[], valid while a dialog is active */
+static uint8_t arrow_char[ARROW_COUNT];
+
 static view_t *view = NULL;
 
+/* Formatted vselect items, a few around the shown ones so that scrolling
+ * doesn't wait on the source */
+#define VSELECT_CACHE_SIZE 4
+
+typedef struct vselect_entry_t {
+	const vselect_source_t *source;
+	uint32_t index;
+	char text[PANEL_LCD_COLS / 2];
+} vselect_entry_t;
+
+static vselect_entry_t vselect_cache[VSELECT_CACHE_SIZE];
+static uint8_t vselect_cache_next = 0;
+static int8_t vselect_dir = 1;
+
 static void dialog_draw(void);
+static void dialog_refresh(void);
+static void vselect_check_changed(void);
 static void dialog_button_func(button_t button, bool down, uint32_t time);
+static void dialog_button_event(button_t button, bool down);
+static void dialog_button_step(button_t button);
 static int dialog_find_control(button_t button);
+static void dialog_edit_cells(int col, const char *old, const char *s,
+		int len);
+static void dialog_edit_text(control_text_t *text, char old);
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t len);
 static void trim_inplace(char *s);
 
-static void dialog_button_func(button_t button, _Bool down, uint32_t time)
+/* Set while a batch of several coalesced key presses is applied,
+ * dialog_draw() then only records that a draw is due */
+static bool draw_deferred = false;
+static bool draw_pending = false;
+
+/* Views are worked on by the button task as it handles events and by
+ * whichever task opens and closes the menu, each holds dialog_lock while it
+ * does.  It is recursive since actions enter and exit dialogs from inside
+ * the button callback. */
+static xSemaphoreHandle dialog_lock = NULL;
+
+static void dialog_lock_take(void)
+{
+	xSemaphoreTakeRecursive(dialog_lock, portMAX_DELAY);
+}
+
+static void dialog_lock_give(void)
+{
+	xSemaphoreGiveRecursive(dialog_lock);
+}
+
+/* An event that was already on its way when the last view closed finds no
+ * view and is dropped */
+static void dialog_button_func(button_t button, bool down, uint32_t time)
+{
+	dialog_lock_take();
+	if (view) {
+		dialog_button_event(button, down);
+	}
+	dialog_lock_give();
+}
+
+static void dialog_button_event(button_t button, bool down)
 {
-	control_head_t* control = view->dialog->controls[view->row];
-	uint8_t len;
 	if (!down) {
 		return;
 	}
 
+	/* Something shown may have changed outside of the dialog */
+	if (button == BTN_NONE) {
+		vselect_check_changed();
+		dialog_refresh();
+		return;
+	}
+
+	/* Queued auto-repeats of the same key become one state change and one
+	 * redraw.  Enter is left alone, its actions can replace the view. */
+	int count = 1;
+	if (button != BTN_ENTER) {
+		count += button_coalesce(button);
+	}
+
+	draw_deferred = count > 1;
+	while (count-- > 0) {
+		dialog_button_step(button);
+	}
+	draw_deferred = false;
+
+	if (draw_pending) {
+		draw_pending = false;
+		if (view) {
+			dialog_draw();
+		}
+	}
+}
+
+/* Character classes the text editor cycles through, in order */
+static const struct {
+	char first;
+	char last;
+} text_classes[] = {
+	{' ', ' '}, {'a', 'z'}, {'A', 'Z'}, {'0', '9'},
+	{'!', '.'}, {':', '@'}, {'[', '_'}, {'{', '~'},
+};
+
+/* Moves *c to the first character of the next class, or the last one of the
+ * previous class.  Returns false if *c isn't in any class. */
+static bool text_class_jump(char *c, int dir)
+{
+	const int n = sizeof(text_classes) / sizeof(text_classes[0]);
+	char ch = *c ? *c : ' ';
+
+	for (int i = 0; i < n; i++) {
+		if (ch >= text_classes[i].first && ch <= text_classes[i].last) {
+			if (dir > 0) {
+				*c = text_classes[(i + 1) % n].first;
+			} else {
+				*c = text_classes[(i + n - 1) % n].last;
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void dialog_button_step(button_t button)
+{
+	control_head_t* control = view->dialog->controls[view->row];
+	uint8_t len;
+	/* Held at the fastest repeat rate, controls take bigger steps */
+	bool fast = button_repeat_level() == BUTTON_REPEAT_FAST;
+
 	if (!view->is_active) {
 		if (button == BTN_ENTER) {
 			switch (control->type) {
@@ -87,6 +275,7 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 			}
 
 			case CONTROL_TYPE_SELECT:
+			case CONTROL_TYPE_VSELECT:
 				view->is_active = true;
 				dialog_draw();
 				break;
@@ -121,6 +310,11 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 	case BTN_UP:
 		if (control->type == CONTROL_TYPE_TEXT) {
 			control_text_t *text = (control_text_t *) control;
+			char old = text->value[view->edit_cursor];
+			if (fast && text_class_jump(&text->value[view->edit_cursor], 1)) {
+				dialog_edit_text(text, old);
+				break;
+			}
 			switch (text->value[view->edit_cursor]) {
 			case '\0':
 			case ' ':
@@ -158,38 +352,53 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 			default:
 				text->value[view->edit_cursor] += 1;
 			}
-			dialog_draw();
+			dialog_edit_text(text, old);
 		} else if (control->type == CONTROL_TYPE_SELECT) {
 			control_select_t *select = (control_select_t *) control;
 			if (*select->index > 0) {
-				*select->index -= 1;
+				*select->index = max(0, *select->index - (fast ? 10 : 1));
+				dialog_draw();
+			}
+		} else if (control->type == CONTROL_TYPE_VSELECT) {
+			control_vselect_t *vselect = (control_vselect_t *)control;
+			uint32_t step = fast ? 10 : 1;
+			if (*vselect->index > 0) {
+				*vselect->index -= min(step, *vselect->index);
+				vselect_dir = -1;
 				dialog_draw();
 			}
 		} else if (control->type == CONTROL_TYPE_IP) {
 			control_ip_t *ip = (control_ip_t *)control;
 			int octet = ip->addr->addr >> (24 - (view->edit_cursor / 3 * 8)) & 0xFF;
 			int digit = view->edit_cursor % 3;
+			int step = digit == 0 ? 100 : digit == 1 ? 10 : 1;
 
-			if (digit == 0) {
-				octet += 100;
-			} else if (digit == 1) {
-				octet += 10;
-			} else if (digit == 2) {
-				octet += 1;
+			if (fast && step < 100) {
+				step *= 10;
 			}
+			char old[4], new[4];
+			sprintf(old, "%3d", octet);
+			octet += step;
 
 			if (octet > 255) {
 				octet = 255;
 			}
 			ip->addr->addr &= ~(0xFF << (24 - (view->edit_cursor / 3 * 8)));
 			ip->addr->addr |= octet << (24 - (view->edit_cursor / 3 * 8));
-			dialog_draw();
+			sprintf(new, "%3d", octet);
+			dialog_edit_cells(PANEL_LCD_COLS / 2 + view->edit_cursor / 3 * 4,
+					old, new, 3);
 		}
 		break;
 
 	case BTN_DOWN:
 		if (control->type == CONTROL_TYPE_TEXT) {
 			control_text_t *text = (control_text_t *) control;
+			char old = text->value[view->edit_cursor];
+			if (fast && text_class_jump(&text->value[view->edit_cursor], -1)) {
+				dialog_edit_text(text, old);
+				break;
+			}
 			switch (text->value[view->edit_cursor]) {
 			case 'a':
 				text->value[view->edit_cursor] = ' ';
@@ -227,32 +436,44 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 			default:
 				text->value[view->edit_cursor] -= 1;
 			}
-			dialog_draw();
+			dialog_edit_text(text, old);
 		} else if (control->type == CONTROL_TYPE_SELECT) {
 			control_select_t *select = (control_select_t *)control;
 			if (*select->index < select->size - 1) {
-				*select->index += 1;
+				*select->index = min(select->size - 1,
+						*select->index + (fast ? 10 : 1));
+				dialog_draw();
+			}
+		} else if (control->type == CONTROL_TYPE_VSELECT) {
+			control_vselect_t *vselect = (control_vselect_t *)control;
+			uint32_t count = vselect->source->count(vselect->source->ctx);
+			uint32_t step = fast ? 10 : 1;
+			if (*vselect->index + 1 < count) {
+				*vselect->index = min(count - 1, *vselect->index + step);
+				vselect_dir = 1;
 				dialog_draw();
 			}
 		} else if (control->type == CONTROL_TYPE_IP) {
 			control_ip_t *ip = (control_ip_t *)control;
 			int octet = ip->addr->addr >> (24 - (view->edit_cursor / 3 * 8)) & 0xFF;
 			int digit = view->edit_cursor % 3;
+			int step = digit == 0 ? 100 : digit == 1 ? 10 : 1;
 
-			if (digit == 0) {
-				octet -= 100;
-			} else if (digit == 1) {
-				octet -= 10;
-			} else if (digit == 2) {
-				octet -= 1;
+			if (fast && step < 100) {
+				step *= 10;
 			}
+			char old[4], new[4];
+			sprintf(old, "%3d", octet);
+			octet -= step;
 
 			if (octet < 0) {
 				octet = 0;
 			}
 			ip->addr->addr &= ~(0xFF << (24 - (view->edit_cursor / 3 * 8)));
 			ip->addr->addr |= octet << (24 - (view->edit_cursor / 3 * 8));
-			dialog_draw();
+			sprintf(new, "%3d", octet);
+			dialog_edit_cells(PANEL_LCD_COLS / 2 + view->edit_cursor / 3 * 4,
+					old, new, 3);
 		}
 		break;
 
@@ -263,13 +484,15 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 				if (view->edit_offset > 0
 						&& view->edit_cursor < view->edit_offset + 1) {
 					view->edit_offset -= 1;
+					dialog_draw();
+				} else {
+					dialog_edit_cells(0, NULL, NULL, 0);
 				}
-				dialog_draw();
 			}
 		} else if (control->type == CONTROL_TYPE_IP) {
 			if (view->edit_cursor > 0) {
 				view->edit_cursor -= 1;
-				dialog_draw();
+				dialog_edit_cells(0, NULL, NULL, 0);
 			}
 		}
 		break;
@@ -283,6 +506,7 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 				break;
 			}
 			if (view->edit_cursor <= len) {
+				uint8_t offset = view->edit_offset;
 				view->edit_cursor += 1;
 				if (view->edit_cursor > view->edit_offset + width - 1
 						|| (view->edit_cursor < len - 1
@@ -295,12 +519,17 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 					text->value[view->edit_cursor] = ' ';
 					text->value[view->edit_cursor + 1] = '\0';
 				}
-				dialog_draw();
+				/* The space appended at the end lands on a blank cell */
+				if (view->edit_offset != offset) {
+					dialog_draw();
+				} else {
+					dialog_edit_cells(0, NULL, NULL, 0);
+				}
 			}
 		} else if (control->type == CONTROL_TYPE_IP) {
 			if (view->edit_cursor < 11) {
 				view->edit_cursor += 1;
-				dialog_draw();
+				dialog_edit_cells(0, NULL, NULL, 0);
 			}
 		}
 		break;
@@ -320,20 +549,153 @@ static void dialog_button_func(button_t button, _Bool down, uint32_t time)
 			if (select->change) {
 				select->change(view);
 			}
+		} else if (control->type == CONTROL_TYPE_VSELECT) {
+			control_vselect_t *vselect = (control_vselect_t *)control;
+			if (vselect->change) {
+				vselect->change(view);
+			}
 		}
 		dialog_draw();
 		break;
+
+	default:
+		break;
+	}
+}
+
+#if CONFIG_PANEL_MARQUEE_MS > 0
+/* The first field of the selected row that is too long scrolls through its
+ * cells.  Steps are taken by the button task when the marquee timer wakes
+ * it, so key events queue up in between as usual. */
+#define MARQUEE_GAP 4
+#define MARQUEE_HOLD 3
+#define MARQUEE_TICKS max(1, CONFIG_PANEL_MARQUEE_MS / portTICK_PERIOD_MS)
+
+typedef struct marquee_t {
+	const char *text;
+	uint32_t hash;
+	uint8_t address;
+	uint8_t width;
+	uint8_t pos;
+	TickType_t next;
+} marquee_t;
+
+static marquee_t marquee;
+static xTimerHandle marquee_timer = NULL;
+/* Set while the selected row is drawn, and once its marquee field is seen */
+static bool marquee_focus = false;
+static bool marquee_seen = false;
+
+/* Runs in the timer task like dialog_refresh_cb(), button_wake() posts
+ * without waiting.  A dropped wake only holds the scroll for one step. */
+static void dialog_marquee_cb(xTimerHandle pxTimer)
+{
+	button_wake();
+}
+
+static void marquee_stop(void)
+{
+	if (marquee.text) {
+		marquee.text = NULL;
+		xTimerStop(marquee_timer, portMAX_DELAY);
 	}
 }
 
+static void marquee_fill(uint8_t *buf, int len)
+{
+	for (int i = 0; i < marquee.width; i++) {
+		int k = (marquee.pos + i) % (len + MARQUEE_GAP);
+		buf[i] = k < len ? marquee.text[k] : ' ';
+	}
+}
+
+/* Renders s into buf if it is the selected row's marquee field */
+static bool marquee_field(const char *s, int field_len, uint8_t *buf)
+{
+	int len = strlen(s);
+
+	if (!marquee_focus || marquee_seen || len <= field_len) {
+		return false;
+	}
+	marquee_seen = true;
+
+	uint8_t address = lcd_get_address();
+	uint32_t hash = hash_bytes(2166136261, s, len);
+	if (marquee.text != s || marquee.hash != hash ||
+			marquee.address != address) {
+		if (!marquee_timer) {
+			marquee_timer = xTimerCreate("marquee", MARQUEE_TICKS, pdTRUE,
+					NULL, dialog_marquee_cb);
+		}
+		if (!marquee.text) {
+			xTimerStart(marquee_timer, portMAX_DELAY);
+		}
+		marquee.text = s;
+		marquee.hash = hash;
+		marquee.address = address;
+		marquee.width = field_len;
+		marquee.pos = 0;
+		marquee.next = xTaskGetTickCount() + MARQUEE_TICKS * MARQUEE_HOLD;
+	}
+
+	marquee_fill(buf, len);
+	return true;
+}
+
+/* Advances the marquee if a step is due, only its field is rewritten */
+static void marquee_step(void)
+{
+	uint8_t buf[PANEL_LCD_COLS];
+
+	if (!marquee.text || (int32_t)(xTaskGetTickCount() - marquee.next) < 0) {
+		return;
+	}
+
+	int len = strlen(marquee.text);
+	if (len <= marquee.width) {
+		/* the row redraws itself once its value changed */
+		marquee_stop();
+		return;
+	}
+
+	marquee.pos = (marquee.pos + 1) % (len + MARQUEE_GAP);
+	marquee.next = xTaskGetTickCount() +
+			MARQUEE_TICKS * (marquee.pos == 0 ? MARQUEE_HOLD : 1);
+	marquee_fill(buf, len);
+
+	lcd_fb_begin();
+	lcd_command(0x80 | marquee.address);
+	lcd_data_buf(buf, marquee.width);
+	lcd_fb_end();
+}
+
+static bool marquee_on_row(int lcd_row)
+{
+	return marquee.text && (marquee.address >= 0x40) == (lcd_row > 0);
+}
+#else
+static inline void marquee_stop(void) {}
+static inline void marquee_step(void) {}
+static inline bool marquee_on_row(int lcd_row) { return false; }
+#endif
+
 static void dialog_field(const char *s, int field_len)
 {
-	while (*s && field_len-- > 0) {
-		lcd_data(*s++);
+	uint8_t buf[PANEL_LCD_COLS];
+	int n = 0;
+
+	field_len = min(field_len, PANEL_LCD_COLS);
+#if CONFIG_PANEL_MARQUEE_MS > 0
+	if (marquee_field(s, field_len, buf)) {
+		lcd_data_buf(buf, field_len);
+		return;
 	}
-	while (field_len-- > 0) {
-		lcd_data(' ');
+#endif
+	while (*s && n < field_len) {
+		buf[n++] = *s++;
 	}
+	memset(buf + n, ' ', field_len - n);
+	lcd_data_buf(buf, field_len);
 }
 
 static int get_cols(control_head_t *control)
@@ -349,7 +711,7 @@ static int get_cols(control_head_t *control)
 
 static int dialog_find_control(button_t button)
 {
-	dialog_t *dialog = view->dialog;
+	const dialog_t *dialog = view->dialog;
 	int row = view->row;
 	int col = view->col;
 	int cols;
@@ -393,7 +755,7 @@ static void dialog_draw_static(int row)
 	int width = PANEL_LCD_COLS / 2;
 
 	if (row == view->row) {
-		lcd_data('\x01');
+		lcd_data(arrow_char[ARROW_RIGHT]);
 	} else {
 		lcd_data(' ');
 	}
@@ -420,14 +782,14 @@ static void dialog_draw_button2x(int row)
 	int width = PANEL_LCD_COLS / 2;
 
 	if (row == view->row && view->col == 0) {
-		lcd_data('\x01');
+		lcd_data(arrow_char[ARROW_RIGHT]);
 	} else {
 		lcd_data(' ');
 	}
 	dialog_field(button2x->label, width - 1);
 
 	if (row == view->row && view->col == 1) {
-		lcd_data('\x01');
+		lcd_data(arrow_char[ARROW_RIGHT]);
 	} else {
 		lcd_data(' ');
 	}
@@ -441,7 +803,7 @@ static void dialog_draw_text(int row)
 
 	if (!view->is_active) {
 		if (row == view->row) {
-			lcd_data('\x01');
+			lcd_data(arrow_char[ARROW_RIGHT]);
 		} else {
 			lcd_data(' ');
 		}
@@ -455,7 +817,7 @@ static void dialog_draw_text(int row)
 		if (view->edit_offset > 0) {
 			width -= 1;
 			offset += 1;
-			lcd_data('\x00');
+			lcd_data(arrow_char[ARROW_LEFT]);
 		}
 		if (strlen(text->value) > view->edit_offset + width + offset) {
 			width -= 1;
@@ -463,7 +825,7 @@ static void dialog_draw_text(int row)
 		}
 		dialog_field(text->value + view->edit_offset + offset, width);
 		if (right_arrow) {
-			lcd_data('\x01');
+			lcd_data(arrow_char[ARROW_RIGHT]);
 		}
 		lcd_command(0x80 | (lcd_row << 6) | (PANEL_LCD_COLS / 2 + view->edit_cursor - view->edit_offset));
 		lcd_command(0x0E); /* Show cursor */
@@ -476,7 +838,7 @@ static void dialog_draw_toggle(int row)
 	int width = PANEL_LCD_COLS;
 
 	if (row == view->row) {
-		lcd_data('\x01');
+		lcd_data(arrow_char[ARROW_RIGHT]);
 	} else {
 		lcd_data(' ');
 	}
@@ -492,28 +854,133 @@ static void dialog_draw_select(int row)
 
 	if (!view->is_active) {
 		if (row == view->row) {
-			lcd_data('\x01');
+			lcd_data(arrow_char[ARROW_RIGHT]);
 		} else {
 			lcd_data(' ');
 		}
 		width /= 2;
 		dialog_field(select->label, width - 1);
 		dialog_field(select->list[*select->index], width - 1);
+		lcd_data(' ');
 	} else {
 		int lcd_row = view->row - view->window_row;
 		lcd_command(0x80 | (lcd_row << 6) | PANEL_LCD_COLS / 2);
 		if (*select->index == 0) {
-			lcd_data('\x03');
+			lcd_data(arrow_char[ARROW_DOWN]);
 		} else if (*select->index == select->size - 1){
-			lcd_data('\x02');
+			lcd_data(arrow_char[ARROW_UP]);
 		} else {
-			lcd_data('\x04');
+			lcd_data(arrow_char[ARROW_UPDOWN]);
 		}
 		const char *s = select->list[*select->index];
 		dialog_field(s, PANEL_LCD_COLS / 2 - 1);
 	}
 }
 
+static const char *vselect_text(const vselect_source_t *source,
+		uint32_t index)
+{
+	vselect_entry_t *entry;
+
+	for (int i = 0; i < VSELECT_CACHE_SIZE; i++) {
+		entry = &vselect_cache[i];
+		if (entry->source == source && entry->index == index) {
+			return entry->text;
+		}
+	}
+
+	entry = &vselect_cache[vselect_cache_next];
+	vselect_cache_next = (vselect_cache_next + 1) % VSELECT_CACHE_SIZE;
+
+	const void *item = source->get(source->ctx, index);
+	entry->source = source;
+	entry->index = index;
+	entry->text[0] = '\0';
+	if (item && source->format) {
+		source->format(source->ctx, item, entry->text, sizeof(entry->text));
+	} else if (item) {
+		strncpy(entry->text, item, sizeof(entry->text) - 1);
+		entry->text[sizeof(entry->text) - 1] = '\0';
+	}
+
+	return entry->text;
+}
+
+/* Drops cached items of a source whose contents changed, or of all sources
+ * if source is NULL */
+void vselect_invalidate(const vselect_source_t *source)
+{
+	for (int i = 0; i < VSELECT_CACHE_SIZE; i++) {
+		if (!source || vselect_cache[i].source == source) {
+			vselect_cache[i].source = NULL;
+		}
+	}
+}
+
+/* Drops the cached items of the sources in the dialog that report a change */
+static void vselect_check_changed(void)
+{
+	if (!view) {
+		return;
+	}
+
+	for (int row = 0; row < view->dialog->count; row++) {
+		control_vselect_t *vselect = (control_vselect_t *)view->dialog->controls[row];
+		if (vselect->type == CONTROL_TYPE_VSELECT && vselect->source->changed &&
+				vselect->source->changed(vselect->source->ctx)) {
+			vselect_invalidate(vselect->source);
+		}
+	}
+}
+
+static void dialog_draw_vselect(int row)
+{
+	control_vselect_t *vselect = (control_vselect_t *)view->dialog->controls[row];
+	const vselect_source_t *source = vselect->source;
+	uint32_t count = source->count(source->ctx);
+	int width = PANEL_LCD_COLS;
+
+	if (*vselect->index >= count) {
+		*vselect->index = count ? count - 1 : 0;
+	}
+	const char *s = count ? vselect_text(source, *vselect->index) : "";
+
+	if (!view->is_active) {
+		if (row == view->row) {
+			lcd_data(arrow_char[ARROW_RIGHT]);
+		} else {
+			lcd_data(' ');
+		}
+		width /= 2;
+		dialog_field(vselect->label, width - 1);
+		dialog_field(s, width - 1);
+		lcd_data(' ');
+	} else {
+		int lcd_row = view->row - view->window_row;
+		lcd_command(0x80 | (lcd_row << 6) | PANEL_LCD_COLS / 2);
+		if (count <= 1) {
+			lcd_data(' ');
+		} else if (*vselect->index == 0) {
+			lcd_data(arrow_char[ARROW_DOWN]);
+		} else if (*vselect->index == count - 1) {
+			lcd_data(arrow_char[ARROW_UP]);
+		} else {
+			lcd_data(arrow_char[ARROW_UPDOWN]);
+		}
+		dialog_field(s, PANEL_LCD_COLS / 2 - 1);
+	}
+}
+
+static void dialog_vselect_prefetch(control_vselect_t *vselect)
+{
+	const vselect_source_t *source = vselect->source;
+	uint32_t next = *vselect->index + vselect_dir;
+
+	if (next < source->count(source->ctx)) {
+		vselect_text(source, next);
+	}
+}
+
 static void dialog_draw_ip(int row)
 {
 	control_ip_t *ip = (control_ip_t *)view->dialog->controls[row];
@@ -523,7 +990,7 @@ static void dialog_draw_ip(int row)
 
 	if (!view->is_active) {
 		if (row == view->row) {
-			lcd_data('\x01');
+			lcd_data(arrow_char[ARROW_RIGHT]);
 		} else {
 			lcd_data(' ');
 		}
@@ -554,13 +1021,236 @@ static void dialog_draw_ip(int row)
 	}
 }
 
+/* FNV-1a over what a row shows that can change without a key press */
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		hash = (hash ^ *p++) * 16777619;
+	}
+	return hash;
+}
+
+static uint32_t dialog_row_hash(int row)
+{
+	control_head_t *control = view->dialog->controls[row];
+	uint32_t hash = 2166136261;
+
+	switch (control->type) {
+	case CONTROL_TYPE_STATIC: {
+		control_static_t *static_ = (control_static_t *)control;
+		if (static_->value) {
+			hash = hash_bytes(hash, static_->value, strlen(static_->value));
+		}
+		break;
+	}
+
+	case CONTROL_TYPE_TEXT: {
+		control_text_t *text = (control_text_t *)control;
+		hash = hash_bytes(hash, text->value, strnlen(text->value, text->size));
+		break;
+	}
+
+	case CONTROL_TYPE_TOGGLE:
+		hash = hash_bytes(hash, ((control_toggle_t *)control)->index, 1);
+		break;
+
+	case CONTROL_TYPE_SELECT:
+		hash = hash_bytes(hash, ((control_select_t *)control)->index, 1);
+		break;
+
+	case CONTROL_TYPE_IP:
+		hash = hash_bytes(hash, ((control_ip_t *)control)->addr,
+				sizeof(ip4_addr_t));
+		break;
+
+	case CONTROL_TYPE_VSELECT: {
+		control_vselect_t *vselect = (control_vselect_t *)control;
+		const vselect_source_t *source = vselect->source;
+		uint32_t count = source->count(source->ctx);
+		hash = hash_bytes(hash, &count, sizeof(count));
+		hash = hash_bytes(hash, vselect->index, sizeof(*vselect->index));
+		if (*vselect->index < count) {
+			const char *s = vselect_text(source, *vselect->index);
+			hash = hash_bytes(hash, s, strlen(s));
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	return hash;
+}
+
+/* Runs the update hooks of the rows in the window, a hook that both rows
+ * share only once */
+static void dialog_update(void)
+{
+	event_cb_t last = NULL;
+
+	for (int row = view->window_row; row < min(view->dialog->count, view->window_row + PANEL_LCD_ROWS); row++) {
+		control_static_t *static_ = (control_static_t *)view->dialog->controls[row];
+		if (static_->type == CONTROL_TYPE_STATIC && static_->update &&
+				static_->update != last) {
+			last = static_->update;
+			static_->update(view);
+		}
+	}
+}
+
+static void dialog_draw_row(int row)
+{
+	control_head_t *control = view->dialog->controls[row];
+
+	lcd_command(0x80 | ((row - view->window_row) << 6));
+#if CONFIG_PANEL_MARQUEE_MS > 0
+	marquee_focus = row == view->row;
+	marquee_seen = false;
+#endif
+	switch (control->type) {
+	case CONTROL_TYPE_STATIC:
+		dialog_draw_static(row);
+		break;
+
+	case CONTROL_TYPE_BUTTON:
+		dialog_draw_button(row);
+		break;
+
+	case CONTROL_TYPE_BUTTON2X:
+		dialog_draw_button2x(row);
+		break;
+
+	case CONTROL_TYPE_TEXT:
+		dialog_draw_text(row);
+		break;
+
+	case CONTROL_TYPE_TOGGLE:
+		dialog_draw_toggle(row);
+		break;
+
+	case CONTROL_TYPE_SELECT:
+		dialog_draw_select(row);
+		break;
+
+	case CONTROL_TYPE_IP:
+		dialog_draw_ip(row);
+		break;
+
+	case CONTROL_TYPE_VSELECT:
+		dialog_draw_vselect(row);
+		break;
+	}
+
+	view->row_hash[row - view->window_row] = dialog_row_hash(row);
+#if CONFIG_PANEL_MARQUEE_MS > 0
+	if (marquee_focus && !marquee_seen) {
+		marquee_stop();
+	}
+	marquee_focus = false;
+#endif
+}
+
+/* LCD column of the cursor of the active text or IP control */
+static int dialog_edit_col(void)
+{
+	control_head_t *control = view->dialog->controls[view->row];
+
+	if (control->type == CONTROL_TYPE_IP) {
+		return PANEL_LCD_COLS / 2 + view->edit_cursor + view->edit_cursor / 3;
+	}
+	return PANEL_LCD_COLS / 2 + view->edit_cursor - view->edit_offset;
+}
+
+/* Rewrites the span of cells that differs between old and s in place, then
+ * puts the cursor back.  With len 0 this only moves the cursor.  Edits that
+ * scroll the field or change its arrows need dialog_draw() instead. */
+static void dialog_edit_cells(int col, const char *old, const char *s,
+		int len)
+{
+	int lcd_row = view->row - view->window_row;
+	int first = 0;
+	int last = len - 1;
+
+	if (draw_deferred) {
+		draw_pending = true;
+		return;
+	}
+
+	while (first < len && old[first] == s[first]) {
+		first++;
+	}
+	while (last >= first && old[last] == s[last]) {
+		last--;
+	}
+	if (len > 0 && first > last) {
+		return;
+	}
+
+	if (first <= last) {
+		lcd_command(0x80 | (lcd_row << 6) | (col + first));
+		lcd_data_buf((const uint8_t *)s + first, last - first + 1);
+	}
+	lcd_command(0x80 | (lcd_row << 6) | dialog_edit_col());
+	view->row_hash[lcd_row] = dialog_row_hash(view->row);
+}
+
+/* Shows the character under the cursor after it changed from old.  Filling
+ * in the end of the text makes it longer, which can bring up the right
+ * arrow, so that redraws the field. */
+static void dialog_edit_text(control_text_t *text, char old)
+{
+	if (old == '\0') {
+		dialog_draw();
+		return;
+	}
+	dialog_edit_cells(dialog_edit_col(), &old,
+			&text->value[view->edit_cursor], 1);
+}
+
+/* Rewrites the selection marker cells of a row */
+static void dialog_draw_markers(int row)
+{
+	control_head_t *control = view->dialog->controls[row];
+	int lcd_row = row - view->window_row;
+	bool focus = row == view->row;
+
+	lcd_command(0x80 | (lcd_row << 6));
+	switch (control->type) {
+	case CONTROL_TYPE_BUTTON:
+		lcd_data(focus ? '>' : ' ');
+		break;
+
+	case CONTROL_TYPE_BUTTON2X:
+		lcd_data(focus && view->col == 0 ? arrow_char[ARROW_RIGHT] : ' ');
+		lcd_command(0x80 | (lcd_row << 6) | PANEL_LCD_COLS / 2);
+		lcd_data(focus && view->col == 1 ? arrow_char[ARROW_RIGHT] : ' ');
+		break;
+
+	default:
+		lcd_data(focus ? arrow_char[ARROW_RIGHT] : ' ');
+		break;
+	}
+}
+
 static void dialog_draw(void)
 {
 	control_head_t *control = view->dialog->controls[view->row];
 
+	if (draw_deferred) {
+		draw_pending = true;
+		return;
+	}
+
+	lcd_fb_begin();
+
 	if (view->is_active) {
 		int lcd_row = view->row - view->window_row;
 
+		marquee_stop();
+
 		lcd_command(0x80 | (lcd_row << 6));
 		lcd_data(' ');
 
@@ -577,79 +1267,230 @@ static void dialog_draw(void)
 			dialog_draw_ip(view->row);
 			break;
 
+		case CONTROL_TYPE_VSELECT:
+			dialog_draw_vselect(view->row);
+			break;
+
 		default:
 			break;
 		}
-		return;
-	}
+		view->row_hash[lcd_row] = dialog_row_hash(view->row);
+		lcd_fb_end();
 
-	if (view->window_row != view->window_row_last) {
-		lcd_command(0x01); /* Clear display */
+		/* Fetch the next item once this one is on its way */
+		if (control->type == CONTROL_TYPE_VSELECT) {
+			dialog_vselect_prefetch((control_vselect_t *)control);
+		}
+		return;
 	}
 
-	for (int row = view->window_row; row < min(view->dialog->count, view->window_row + PANEL_LCD_ROWS); row++) {
-		control_head_t *control = view->dialog->controls[row];
-		lcd_command(0x80 | ((row - view->window_row) << 6));
-		switch (control->type) {
-		case CONTROL_TYPE_STATIC:
-			dialog_draw_static(row);
-			break;
+	/* Rows fill the whole line, so nothing needs clearing.  A row that
+	 * stays on screen as the window scrolls is copied from the shadow. */
+	bool scrolled = view->window_row_last != (uint8_t)-1 &&
+			view->window_row != view->window_row_last;
+	uint8_t shown[PANEL_LCD_ROWS][PANEL_LCD_COLS];
+	uint32_t shown_hash[PANEL_LCD_ROWS];
 
-		case CONTROL_TYPE_BUTTON:
-			dialog_draw_button(row);
-			break;
+	if (view->window_row_last == (uint8_t)-1 && lcd_get_state()->display_shift) {
+		lcd_command(0x02); /* Return home */
+	}
+	if (scrolled) {
+		memcpy(shown, lcd_get_state()->ddram_data, sizeof(shown));
+		memcpy(shown_hash, view->row_hash, sizeof(shown_hash));
+	}
 
-		case CONTROL_TYPE_BUTTON2X:
-			dialog_draw_button2x(row);
-			break;
+	dialog_update();
+	for (int lcd_row = 0; lcd_row < PANEL_LCD_ROWS; lcd_row++) {
+		int row = view->window_row + lcd_row;
+		int last_lcd_row = row - view->window_row_last;
+
+		if (row >= view->dialog->count) {
+			lcd_command(0x80 | (lcd_row << 6));
+			dialog_field("", PANEL_LCD_COLS);
+		} else if (scrolled && last_lcd_row >= 0 &&
+				last_lcd_row < PANEL_LCD_ROWS && row != view->row &&
+				!marquee_on_row(last_lcd_row)) {
+			lcd_command(0x80 | (lcd_row << 6));
+			lcd_data_buf(shown[last_lcd_row], PANEL_LCD_COLS);
+			dialog_draw_markers(row);
+			view->row_hash[lcd_row] = shown_hash[last_lcd_row];
+		} else {
+			dialog_draw_row(row);
+		}
+	}
 
-		case CONTROL_TYPE_TEXT:
-			dialog_draw_text(row);
-			break;
+	view->window_row_last = view->window_row;
+	lcd_fb_end();
+}
 
-		case CONTROL_TYPE_TOGGLE:
-			dialog_draw_toggle(row);
-			break;
+/* Redraws only the shown rows whose bound value changed since they were
+ * drawn, steady rows cost a hash and no LCD traffic */
+static void dialog_refresh(void)
+{
+	bool drawing = false;
 
-		case CONTROL_TYPE_SELECT:
-			dialog_draw_select(row);
-			break;
+	if (!view) {
+		return;
+	}
 
-		case CONTROL_TYPE_IP:
-			dialog_draw_ip(row);
-			break;
+	if (view->is_active) {
+		int lcd_row = view->row - view->window_row;
+		if (dialog_row_hash(view->row) != view->row_hash[lcd_row]) {
+			dialog_draw();
 		}
+		return;
 	}
 
-	view->window_row_last = view->window_row;
+	marquee_step();
+	dialog_update();
+	for (int row = view->window_row; row < min(view->dialog->count, view->window_row + PANEL_LCD_ROWS); row++) {
+		if (dialog_row_hash(row) == view->row_hash[row - view->window_row]) {
+			continue;
+		}
+		if (!drawing) {
+			lcd_fb_begin();
+			drawing = true;
+		}
+		dialog_draw_row(row);
+	}
+	if (drawing) {
+		lcd_fb_end();
+	}
 }
 
 void dialog_redraw(void)
 {
+	if (!dialog_lock) {
+		return;
+	}
+
+	dialog_lock_take();
 	if (view) {
 		view->window_row_last = -1;
 		dialog_draw();
 	}
+	dialog_lock_give();
+}
+
+/* Dialogs, their controls and views are carved from a stack-like arena and
+ * released in the reverse order they were made, so freeing a dialog just
+ * rewinds the arena to where it starts.  Only the newest dialog grows in the
+ * arena, anything else and whatever doesn't fit goes on the heap, chained to
+ * the dialog that owns it. */
+#define ARENA_ALIGN sizeof(void *)
+#define DIALOG_INITIAL_SIZE 8
+
+typedef struct heap_block_t heap_block_t;
+
+struct heap_block_t {
+	heap_block_t *next;
+};
+
+static uint8_t arena[CONFIG_PANEL_DIALOG_ARENA_SIZE]
+		__attribute__((aligned(ARENA_ALIGN)));
+static uint16_t arena_used = 0;
+static uint16_t arena_peak = 0;
+static uint32_t heap_fallbacks = 0;
+static dialog_t *arena_owner = NULL;
+
+#if CONFIG_PANEL_DIALOG_REFRESH_MS > 0
+/* Wakes the button task to look for changed rows while a dialog is open.
+ * Runs in the timer task, button_wake() never blocks it. */
+static xTimerHandle refresh_timer = NULL;
+
+static void dialog_refresh_cb(xTimerHandle pxTimer)
+{
+	button_wake();
+}
+#endif
+
+static void *arena_alloc(size_t size)
+{
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	if (size > sizeof(arena) - arena_used) {
+		return NULL;
+	}
+
+	void *p = arena + arena_used;
+	arena_used += size;
+	if (arena_used > arena_peak) {
+		arena_peak = arena_used;
+	}
+	return p;
+}
+
+static bool arena_owns(const void *p)
+{
+	return (const uint8_t *)p >= arena &&
+			(const uint8_t *)p < arena + sizeof(arena);
+}
+
+static void arena_release(const void *p)
+{
+	uint16_t offset = (const uint8_t *)p - arena;
+	if (offset < arena_used) {
+		arena_used = offset;
+	}
+	arena_owner = NULL;
+}
+
+static void *dialog_alloc(dialog_t *dialog, size_t size)
+{
+	void *p = NULL;
+
+	if (dialog == arena_owner) {
+		p = arena_alloc(size);
+	}
+	if (!p) {
+		heap_block_t *block = malloc(sizeof(heap_block_t) + size);
+		block->next = dialog->heap;
+		dialog->heap = block;
+		heap_fallbacks++;
+		p = block + 1;
+	}
+	return p;
 }
 
 dialog_t *dialog_new(void)
 {
-	dialog_t *dialog = malloc(sizeof(dialog_t));
-	dialog->count = 0;
+	size_t size = sizeof(dialog_t) + sizeof(void *) * DIALOG_INITIAL_SIZE;
+	dialog_t *dialog = arena_alloc(size);
+	if (dialog) {
+		arena_owner = dialog;
+	} else {
+		dialog = malloc(size);
+		heap_fallbacks++;
+	}
 	dialog->free = dialog_default_free;
+	dialog->count = 0;
+	dialog->size = DIALOG_INITIAL_SIZE;
+	dialog->controls = (control_head_t **)(dialog + 1);
+	dialog->heap = NULL;
 	return dialog;
 }
 
+/* A dialog holds at most UINT8_MAX controls, inserts beyond that are
+ * ignored */
 void dialog_insert(dialog_t **dialog, const void *control, int pos)
 {
 	int count = (*dialog)->count;
+	if (count == UINT8_MAX) {
+		return;
+	}
 	if (pos < 0) {
 		pos = count + pos;
 	}
-	int newsize = sizeof(dialog_t) + sizeof(void *) * (count + 1);
-	*dialog = realloc(*dialog, newsize);
+	control_head_t **controls = (control_head_t **)(*dialog)->controls;
+	if (count == (*dialog)->size) {
+		int size = min(count * 2, UINT8_MAX);
+		/* the old array stays behind until the dialog is freed */
+		controls = dialog_alloc(*dialog, sizeof(void *) * size);
+		memcpy(controls, (*dialog)->controls, sizeof(void *) * count);
+		(*dialog)->controls = controls;
+		(*dialog)->size = size;
+	}
 	if (pos < count) {
-		memmove((*dialog)->controls + pos + 1, (*dialog)->controls + pos, sizeof(void *) * (count - pos));
+		memmove(controls + pos + 1, controls + pos, sizeof(void *) * (count - pos));
 	}
 
 	int control_size;
@@ -676,14 +1517,17 @@ void dialog_insert(dialog_t **dialog, const void *control, int pos)
 	case CONTROL_TYPE_IP:
 		control_size = sizeof(control_ip_t);
 		break;
+	case CONTROL_TYPE_VSELECT:
+		control_size = sizeof(control_vselect_t);
+		break;
 	default:
 		/* TODO: panic! */
 		control_size = sizeof(control_head_t);
 	}
 
-	control_head_t *new_control = malloc(control_size);
+	control_head_t *new_control = dialog_alloc(*dialog, control_size);
 	memcpy(new_control, control, control_size);
-	(*dialog)->controls[pos] = new_control;
+	controls[pos] = new_control;
 	(*dialog)->count = count + 1;
 }
 
@@ -698,9 +1542,10 @@ void dialog_remove(dialog_t **dialog, int pos)
 		pos = (*dialog)->count + pos;
 	}
 
-	free((*dialog)->controls[pos]);
+	/* the control itself is reclaimed with the dialog */
+	control_head_t **controls = (control_head_t **)(*dialog)->controls;
 	if (pos < (*dialog)->count - 1) {
-		memmove((*dialog)->controls + pos, (*dialog)->controls + pos + 1,
+		memmove(controls + pos, controls + pos + 1,
 				sizeof(void *) * ((*dialog)->count - pos - 1));
 	}
 	(*dialog)->count--;
@@ -708,15 +1553,41 @@ void dialog_remove(dialog_t **dialog, int pos)
 
 void dialog_default_free(dialog_t *dialog)
 {
-	for (int i = 0; i < dialog->count; i++) {
-		free(dialog->controls[i]);
+	heap_block_t *block = dialog->heap;
+	while (block) {
+		heap_block_t *next = block->next;
+		free(block);
+		block = next;
+	}
+
+	if (arena_owns(dialog)) {
+		arena_release(dialog);
+	} else {
+		free(dialog);
+	}
+}
+
+/* Constant dialogs have no free function */
+void dialog_free(const dialog_t *dialog)
+{
+	if (dialog->free) {
+		dialog->free((dialog_t *)dialog);
 	}
-	free(dialog);
 }
 
-void dialog_enter(dialog_t *dialog)
+void dialog_enter(const dialog_t *dialog)
 {
-	view_t *new_view = malloc(sizeof(view_t));
+	if (!dialog_lock) {
+		dialog_lock = xSemaphoreCreateRecursiveMutex();
+	}
+	dialog_lock_take();
+
+	view_t *new_view = arena_alloc(sizeof(view_t));
+	if (!new_view) {
+		new_view = malloc(sizeof(view_t));
+		heap_fallbacks++;
+	}
+	arena_owner = NULL;
 	bzero(new_view, sizeof(view_t));
 
 	new_view->parent = view;
@@ -729,76 +1600,72 @@ void dialog_enter(dialog_t *dialog)
 	button_set_cb(dialog_button_func);
 
 	if (!view->parent) {
-		lcd_command(0x40); /* Set CGRAM address */
-
-		/* 0 */
-		lcd_data(0b00000010);
-		lcd_data(0b00000110);
-		lcd_data(0b00001110);
-		lcd_data(0b00011110);
-		lcd_data(0b00001110);
-		lcd_data(0b00000110);
-		lcd_data(0b00000010);
-		lcd_data(0b00000000);
-
-		/* 1 */
-		lcd_data(0b00001000);
-		lcd_data(0b00001100);
-		lcd_data(0b00001110);
-		lcd_data(0b00001111);
-		lcd_data(0b00001110);
-		lcd_data(0b00001100);
-		lcd_data(0b00001000);
-		lcd_data(0b00000000);
-
-		/* 2 */
-		lcd_data(0b00000100);
-		lcd_data(0b00001110);
-		lcd_data(0b00011111);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-
-		/* 3 */
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00000000);
-		lcd_data(0b00011111);
-		lcd_data(0b00001110);
-		lcd_data(0b00000100);
-		lcd_data(0b00000000);
-
-		/* 4 */
-		lcd_data(0b00000100);
-		lcd_data(0b00001110);
-		lcd_data(0b00011111);
-		lcd_data(0b00000000);
-		lcd_data(0b00011111);
-		lcd_data(0b00001110);
-		lcd_data(0b00000100);
-		lcd_data(0b00000000);
+		for (int i = 0; i < ARROW_COUNT; i++) {
+			arrow_char[i] = glyph_get(&arrows[i]);
+		}
+#if CONFIG_PANEL_DIALOG_REFRESH_MS > 0
+		if (!refresh_timer) {
+			refresh_timer = xTimerCreate("dialog",
+					CONFIG_PANEL_DIALOG_REFRESH_MS / portTICK_PERIOD_MS,
+					pdTRUE, NULL, dialog_refresh_cb);
+		}
+		xTimerStart(refresh_timer, portMAX_DELAY);
+#endif
 	}
 	dialog_draw();
+	dialog_lock_give();
 }
 
 void dialog_exit()
 {
+	dialog_lock_take();
+
+	/* The marquee may be scrolling a string of the view going away, the
+	 * view returned to starts its own when it is drawn */
+	marquee_stop();
+
 	view_t *old_view = view;
 	button_set_cb(view->old_button_func);
 	view = view->parent;
-	free(old_view);
+	if (arena_owns(old_view)) {
+		arena_release(old_view);
+	} else {
+		free(old_view);
+	}
+
+	if (!view) {
+		for (int i = 0; i < ARROW_COUNT; i++) {
+			glyph_put(&arrows[i]);
+		}
+#if CONFIG_PANEL_DIALOG_REFRESH_MS > 0
+		xTimerStop(refresh_timer, portMAX_DELAY);
+#endif
+	}
+
+	dialog_lock_give();
 }
 
+/* Closes every view, waiting for an event the button task is handling to
+ * finish first.  The refresh and marquee timers are stopped before anything
+ * is freed. */
 void dialog_terminate(void)
 {
+	if (!dialog_lock) {
+		return;
+	}
+
+	dialog_lock_take();
+#if CONFIG_PANEL_DIALOG_REFRESH_MS > 0
+	if (refresh_timer) {
+		xTimerStop(refresh_timer, portMAX_DELAY);
+	}
+#endif
+	marquee_stop();
 	while (view) {
-		dialog_t *dialog = view->dialog;
-		dialog->free(dialog);
+		dialog_free(view->dialog);
 		dialog_exit();
 	}
+	dialog_lock_give();
 }
 
 bool dialog_active(void)
@@ -806,6 +1673,36 @@ bool dialog_active(void)
 	return !!view;
 }
 
+/* Label of the selected control, or of the selected half of a double button,
+ * NULL without a dialog.  Every control type keeps its label right after the
+ * type. */
+const char *dialog_selected_label(void)
+{
+	if (!view) {
+		return NULL;
+	}
+
+	const control_head_t *control = view->dialog->controls[view->row];
+	if (control->type == CONTROL_TYPE_BUTTON2X && view->col == 1) {
+		return ((const control_button2x_t *)control)->label2;
+	}
+	return ((const control_static_t *)control)->label;
+}
+
+void dialog_get_stats(dialog_stats_t *stats)
+{
+	stats->arena_size = sizeof(arena);
+	stats->arena_used = arena_used;
+	stats->arena_peak = arena_peak;
+	stats->heap_fallbacks = heap_fallbacks;
+}
+
+void dialog_reset_stats(void)
+{
+	arena_peak = arena_used;
+	heap_fallbacks = 0;
+}
+
 static void trim_inplace(char *s)
 {
         int i;
@@ -2,6 +2,7 @@
 #define MENU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <lwip/ip4_addr.h>
 
@@ -16,6 +17,7 @@ typedef enum control_type_t {
 	CONTROL_TYPE_TOGGLE,
 	CONTROL_TYPE_SELECT,
 	CONTROL_TYPE_IP,
+	CONTROL_TYPE_VSELECT,
 } control_type_t;
 
 typedef struct view_t view_t;
@@ -32,7 +34,8 @@ typedef struct view_t {
 	uint8_t edit_offset;
 	uint8_t edit_cursor;
 	bool is_active;
-	dialog_t *dialog;
+	const dialog_t *dialog;
+	uint32_t row_hash[PANEL_LCD_ROWS];
 } view_t;
 
 typedef void (*event_cb_t)(view_t *view);
@@ -40,17 +43,29 @@ typedef void (*event_cb_t)(view_t *view);
 typedef struct dialog_t {
 	void (*free)(dialog_t *dialog);
 	uint8_t count;
-	control_head_t *controls[];
+	uint8_t size;
+	control_head_t *const *controls;
+	void *heap;
 } dialog_t;
 
+typedef struct dialog_stats_t {
+	uint16_t arena_size;
+	uint16_t arena_used;
+	uint16_t arena_peak;
+	uint32_t heap_fallbacks;
+} dialog_stats_t;
+
 typedef struct control_head_t {
 	control_type_t type;
 } control_head_t;
 
+/* update, if set, refreshes value before the row is drawn and on every
+ * refresh tick while the row is shown */
 typedef struct control_static_t {
 	control_type_t type;
 	char *label;
 	char *value;
+	event_cb_t update;
 } control_static_t;
 
 typedef struct control_button_t {
@@ -99,15 +114,102 @@ typedef struct control_ip_t {
 	ip4_addr_t *addr;
 } control_ip_t;
 
+/* Items of a control_vselect_t are fetched by index when shown.  get() may
+ * return NULL for an item that is gone, format() renders an item into buf and
+ * can be NULL if items are strings.  changed(), if set, is asked from the
+ * button task on every button_wake() whether the items changed since it was
+ * last asked, the cached items of a source that did are fetched again. */
+typedef struct vselect_source_t {
+	uint32_t (*count)(void *ctx);
+	const void *(*get)(void *ctx, uint32_t index);
+	void (*format)(void *ctx, const void *item, char *buf, size_t size);
+	bool (*changed)(void *ctx);
+	void *ctx;
+} vselect_source_t;
+
+typedef struct control_vselect_t {
+	control_type_t type;
+	char *label;
+	const vselect_source_t *source;
+	uint32_t *index;
+	event_cb_t change;
+} control_vselect_t;
+
+void vselect_invalidate(const vselect_source_t *source);
+
+/* Constant dialogs are declared as tables and entered as they are, without
+ * copying or allocating anything.  Controls can only point at storage that
+ * outlives the dialog.
+ *
+ *	DIALOG_DEFINE(main_dialog,
+ *		CONTROL_BUTTON("Panel Stats", stats_dialog_show),
+ *		...
+ *	);
+ *
+ *	dialog_enter(&main_dialog);
+ */
+#define DIALOG_DEFINE(name, ...) \
+	static control_head_t *const name##_controls[] = { __VA_ARGS__ }; \
+	static const dialog_t name = { \
+		.count = sizeof(name##_controls) / sizeof(name##_controls[0]), \
+		.controls = name##_controls, \
+	}
+
+#define CONTROL_STATIC(label_, value_) \
+	((control_head_t *)&(const control_static_t){ \
+		.type = CONTROL_TYPE_STATIC, .label = (label_), .value = (value_)})
+
+#define CONTROL_STATIC_LIVE(label_, value_, update_) \
+	((control_head_t *)&(const control_static_t){ \
+		.type = CONTROL_TYPE_STATIC, .label = (label_), .value = (value_), \
+		.update = (update_)})
+
+#define CONTROL_BUTTON(label_, action_) \
+	((control_head_t *)&(const control_button_t){ \
+		.type = CONTROL_TYPE_BUTTON, .label = (label_), .action = (action_)})
+
+#define CONTROL_BUTTON2X(label_, action_, label2_, action2_) \
+	((control_head_t *)&(const control_button2x_t){ \
+		.type = CONTROL_TYPE_BUTTON2X, .label = (label_), .label2 = (label2_), \
+		.action = (action_), .action2 = (action2_)})
+
+#define CONTROL_TEXT(label_, value_, size_, change_) \
+	((control_head_t *)&(const control_text_t){ \
+		.type = CONTROL_TYPE_TEXT, .label = (label_), .value = (value_), \
+		.size = (size_), .change = (change_)})
+
+#define CONTROL_TOGGLE(label_, list_, size_, index_, change_) \
+	((control_head_t *)&(const control_toggle_t){ \
+		.type = CONTROL_TYPE_TOGGLE, .label = (label_), .list = (list_), \
+		.size = (size_), .index = (index_), .change = (change_)})
+
+#define CONTROL_SELECT(label_, list_, size_, index_, change_) \
+	((control_head_t *)&(const control_select_t){ \
+		.type = CONTROL_TYPE_SELECT, .label = (label_), .list = (list_), \
+		.size = (size_), .index = (index_), .change = (change_)})
+
+#define CONTROL_IP(label_, addr_) \
+	((control_head_t *)&(const control_ip_t){ \
+		.type = CONTROL_TYPE_IP, .label = (label_), .addr = (addr_)})
+
+#define CONTROL_VSELECT(label_, source_, index_, change_) \
+	((control_head_t *)&(const control_vselect_t){ \
+		.type = CONTROL_TYPE_VSELECT, .label = (label_), .source = (source_), \
+		.index = (index_), .change = (change_)})
+
 void dialog_redraw(void);
 dialog_t *dialog_new(void);
 void dialog_insert(dialog_t **dialog, const void *control, int pos);
 void dialog_append(dialog_t **dialog, const void *control);
 void dialog_remove(dialog_t **dialog, int pos);
 void dialog_default_free(dialog_t *dialog);
-void dialog_enter(dialog_t *controls);
+void dialog_free(const dialog_t *dialog);
+void dialog_enter(const dialog_t *dialog);
 void dialog_exit(void);
 void dialog_terminate(void);
 bool dialog_active(void);
+const char *dialog_selected_label(void);
+void dialog_get_stats(dialog_stats_t *stats);
+void dialog_reset_stats(void);
 
 #endif /* MENU_H */
@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "glyph.h"
+#include "lcd.h"
+
+/* Maps glyphs onto the eight CGRAM slots.  A slot is pinned while it has
+ * references, otherwise it can be recycled, least recently used first.  The
+ * lcd_state_t shadow is treated as the truth about what each slot holds, so
+ * bitmaps brought back by lcd_restore() are found again without an upload. */
+
+typedef struct slot_t {
+	const glyph_t *glyph;
+	uint8_t refs;
+	uint32_t last_use;
+} slot_t;
+
+static slot_t slots[GLYPH_SLOTS];
+static uint32_t use_count = 0;
+static glyph_stats_t stats;
+
+static bool slot_holds(int n, const glyph_t *glyph)
+{
+	return !memcmp(lcd_get_state()->cgram_data + n * 8, glyph->rows,
+			sizeof(glyph->rows));
+}
+
+static uint8_t slot_use(int n, const glyph_t *glyph)
+{
+	slots[n].glyph = glyph;
+	slots[n].refs++;
+	slots[n].last_use = ++use_count;
+	return n;
+}
+
+uint8_t glyph_get(const glyph_t *glyph)
+{
+	int victim = -1;
+	int n;
+
+	for (n = 0; n < GLYPH_SLOTS; n++) {
+		if (slots[n].glyph == glyph && slot_holds(n, glyph)) {
+			stats.hits++;
+			return slot_use(n, glyph);
+		}
+	}
+
+	for (n = 0; n < GLYPH_SLOTS; n++) {
+		if (slots[n].refs == 0 && slot_holds(n, glyph)) {
+			stats.hits++;
+			return slot_use(n, glyph);
+		}
+	}
+
+	for (n = 0; n < GLYPH_SLOTS; n++) {
+		if (slots[n].refs == 0 &&
+				(victim < 0 || slots[n].last_use < slots[victim].last_use)) {
+			victim = n;
+		}
+	}
+
+	if (victim < 0) {
+		stats.failures++;
+		return ' ';
+	}
+
+	stats.misses++;
+	if (slots[victim].glyph) {
+		stats.evictions++;
+	}
+
+	uint8_t address = lcd_get_address();
+	lcd_seek(0x80 | (victim << 3));
+	lcd_data_buf(glyph->rows, sizeof(glyph->rows));
+	lcd_seek(address);
+
+	return slot_use(victim, glyph);
+}
+
+void glyph_put(const glyph_t *glyph)
+{
+	/* Drop the most recently taken reference */
+	int n, found = -1;
+
+	for (n = 0; n < GLYPH_SLOTS; n++) {
+		if (slots[n].glyph == glyph && slots[n].refs > 0 &&
+				(found < 0 || slots[n].last_use > slots[found].last_use)) {
+			found = n;
+		}
+	}
+
+	if (found >= 0) {
+		slots[found].refs--;
+	}
+}
+
+void glyph_get_stats(glyph_stats_t *out)
+{
+	*out = stats;
+}
+
+void glyph_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,26 @@
+#ifndef _GLYPH_H
+#define _GLYPH_H
+
+#include <stdint.h>
+
+#define GLYPH_SLOTS 8
+
+/* A custom character bitmap.  Screens identify glyphs by the address of
+ * their (usually static const) glyph_t. */
+typedef struct glyph_t {
+	uint8_t rows[8];
+} glyph_t;
+
+typedef struct glyph_stats_t {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t failures;
+} glyph_stats_t;
+
+uint8_t glyph_get(const glyph_t *glyph);
+void glyph_put(const glyph_t *glyph);
+void glyph_get_stats(glyph_stats_t *stats);
+void glyph_reset_stats(void);
+
+#endif /* _GLYPH_H */
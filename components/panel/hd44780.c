@@ -0,0 +1,159 @@
+#include <string.h>
+
+#include "hd44780.h"
+
+/* Model of the HD44780 in 2-line mode as seen over the panel bus.  It keeps
+ * its own DDRAM/CGRAM, address counter and display shift, and accounts for
+ * the bus time of every frame plus the controller's execution time so that
+ * frames arriving while it is still busy can be counted. */
+
+static inline uint8_t ddram_index(uint8_t address)
+{
+	return address < 0x40 ? address : address - 0x40 + 40;
+}
+
+static void step_address(hd44780_t *lcd)
+{
+	if (lcd->cgram_selected) {
+		lcd->address = (lcd->address + (lcd->increment ? 1 : -1)) & 0x3F;
+		return;
+	}
+
+	if (lcd->increment) {
+		lcd->address++;
+		if (lcd->address == 0x28) {
+			lcd->address = 0x40;
+		} else if (lcd->address == 0x68) {
+			lcd->address = 0x00;
+		}
+	} else {
+		lcd->address--;
+		if (lcd->address == 0x3F) {
+			lcd->address = 0x27;
+		} else if (lcd->address == 0xFF) {
+			lcd->address = 0x67;
+		}
+	}
+}
+
+static void shift_display(hd44780_t *lcd, bool left)
+{
+	if (left) {
+		lcd->shift = lcd->shift == 39 ? 0 : lcd->shift + 1;
+	} else {
+		lcd->shift = lcd->shift == 0 ? 39 : lcd->shift - 1;
+	}
+}
+
+static uint32_t execute_command(hd44780_t *lcd, uint8_t byte)
+{
+	if (byte & 0x80) { /* Set DDRAM address */
+		lcd->address = byte & 0x7F;
+		if (lcd->address > 0x27 && lcd->address < 0x40) {
+			lcd->address = 0x40;
+		} else if (lcd->address > 0x67) {
+			lcd->address = 0x00;
+		}
+		lcd->cgram_selected = 0;
+	} else if (byte & 0x40) { /* Set CGRAM address */
+		lcd->address = byte & 0x3F;
+		lcd->cgram_selected = 1;
+	} else if (byte & 0x20) { /* Function set */
+		/* 8-bit, 2-line mode is assumed */
+	} else if (byte & 0x10) { /* Cursor/display shift */
+		if (byte & 0x08) {
+			shift_display(lcd, !(byte & 0x04));
+		} else if (!lcd->cgram_selected) {
+			bool increment = lcd->increment;
+			lcd->increment = !!(byte & 0x04);
+			step_address(lcd);
+			lcd->increment = increment;
+		}
+	} else if (byte & 0x08) { /* Display on/off control */
+		lcd->display_on = !!(byte & 0x04);
+		lcd->cursor_on = !!(byte & 0x02);
+		lcd->cursor_blink = !!(byte & 0x01);
+	} else if (byte & 0x04) { /* Entry mode set */
+		lcd->increment = !!(byte & 0x02);
+		lcd->shift_on_write = !!(byte & 0x01);
+	} else if (byte & 0x02) { /* Return home */
+		lcd->address = 0;
+		lcd->cgram_selected = 0;
+		lcd->shift = 0;
+		lcd->stats.homes++;
+		return HD44780_EXEC_SLOW_US;
+	} else if (byte & 0x01) { /* Clear display */
+		memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+		lcd->address = 0;
+		lcd->cgram_selected = 0;
+		lcd->shift = 0;
+		lcd->increment = 1;
+		lcd->stats.clears++;
+		return HD44780_EXEC_SLOW_US;
+	}
+
+	return HD44780_EXEC_US;
+}
+
+static uint32_t execute_data(hd44780_t *lcd, uint8_t byte)
+{
+	if (lcd->cgram_selected) {
+		lcd->cgram[lcd->address] = byte;
+	} else {
+		lcd->ddram[ddram_index(lcd->address)] = byte;
+		if (lcd->shift_on_write) {
+			shift_display(lcd, lcd->increment);
+		}
+	}
+	step_address(lcd);
+
+	return HD44780_EXEC_DATA_US;
+}
+
+void hd44780_init(hd44780_t *lcd, uint32_t frame_us)
+{
+	memset(lcd, 0, sizeof(*lcd));
+	memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+	lcd->increment = 1;
+	lcd->frame_us = frame_us;
+}
+
+void hd44780_write(hd44780_t *lcd, uint8_t byte, bool data, uint64_t now_us)
+{
+	uint64_t start = now_us > lcd->bus_free ? now_us : lcd->bus_free;
+	uint64_t latched = start + lcd->frame_us;
+	uint32_t exec_us;
+
+	lcd->bus_free = latched;
+	lcd->stats.frames++;
+	lcd->stats.bus_us += lcd->frame_us;
+
+	if (latched < lcd->busy_until) {
+		lcd->stats.busy_violations++;
+	}
+
+	if (data) {
+		lcd->stats.data++;
+		exec_us = execute_data(lcd, byte);
+	} else {
+		lcd->stats.commands++;
+		exec_us = execute_command(lcd, byte);
+	}
+
+	lcd->busy_until = latched + exec_us;
+	lcd->stats.exec_us += exec_us;
+}
+
+void hd44780_read_row(const hd44780_t *lcd, int row, uint8_t *buf)
+{
+	const uint8_t *line = lcd->ddram + (row ? 40 : 0);
+
+	for (int col = 0; col < 40; col++) {
+		buf[col] = lcd->display_on ? line[(col + lcd->shift) % 40] : ' ';
+	}
+}
+
+void hd44780_reset_stats(hd44780_t *lcd)
+{
+	memset(&lcd->stats, 0, sizeof(lcd->stats));
+}
@@ -0,0 +1,45 @@
+#ifndef _HD44780_H
+#define _HD44780_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Execution times at the nominal 270 kHz oscillator, in microseconds */
+#define HD44780_EXEC_US 37
+#define HD44780_EXEC_DATA_US 41
+#define HD44780_EXEC_SLOW_US 1520
+
+typedef struct hd44780_stats_t {
+	uint32_t frames;
+	uint32_t commands;
+	uint32_t data;
+	uint32_t clears;
+	uint32_t homes;
+	uint32_t busy_violations;
+	uint64_t bus_us;
+	uint64_t exec_us;
+} hd44780_stats_t;
+
+typedef struct hd44780_t {
+	uint8_t ddram[80];
+	uint8_t cgram[64];
+	uint8_t address;
+	uint8_t shift;
+	uint8_t cgram_selected : 1;
+	uint8_t increment : 1;
+	uint8_t shift_on_write : 1;
+	uint8_t display_on : 1;
+	uint8_t cursor_on : 1;
+	uint8_t cursor_blink : 1;
+	uint32_t frame_us;
+	uint64_t bus_free;
+	uint64_t busy_until;
+	hd44780_stats_t stats;
+} hd44780_t;
+
+void hd44780_init(hd44780_t *lcd, uint32_t frame_us);
+void hd44780_write(hd44780_t *lcd, uint8_t byte, bool data, uint64_t now_us);
+void hd44780_read_row(const hd44780_t *lcd, int row, uint8_t *buf);
+void hd44780_reset_stats(hd44780_t *lcd);
+
+#endif /* _HD44780_H */
@@ -1,23 +1,228 @@
 #include <string.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 
 #include "panel.h"
 #include "lcd.h"
 
+/* Clear and return home take 1.52 ms at the nominal 270 kHz, the margin
+ * covers a controller running its oscillator at 250 kHz.  The first function
+ * set after power up keeps the 10 ms it has always been given. */
+#define LCD_SLOW_US 1640
+#define LCD_INIT_US 10000
+
 static lcd_state_t lcd_state = {0};
 
+/* Off-screen framebuffer.  While active, DDRAM writes land here and are only
+ * sent to the display by lcd_fb_flush(), which diffs against lcd_state. */
+static uint8_t fb_ddram[80];
+static uint8_t fb_address;
+static uint8_t fb_depth = 0;
+static bool fb_active = false;
+
+/* Address the caller expects, deferred while the cursor is hidden so that a
+ * flush does not end with a redundant address command. */
+static uint8_t address_pending;
+static bool address_is_pending = false;
+
+#if defined(CONFIG_PANEL_LCD_ASYNC)
+/* Display command ring.  Any task may produce, pushes are serialized by
+ * ring_lock so that a burst lands in one piece and only one task at a time
+ * moves head.  The lcd task is the only consumer and the only writer of
+ * tail, so it reads the ring without taking the lock. */
+#define RING_COMMAND LCD_XFER_COMMAND
+#define RING_BUSY 0x0200
+#define RING_BUSY_UNIT_US 64 /* the low byte of a RING_BUSY entry */
+
+static volatile uint16_t ring[CONFIG_PANEL_LCD_RING_SIZE];
+static volatile uint16_t ring_head = 0;
+static volatile uint16_t ring_tail = 0;
+static uint16_t ring_max_depth = 0;
+static uint32_t ring_overflows = 0;
+static xSemaphoreHandle ring_lock = NULL;
+static volatile bool lcd_task_busy = false;
+static xTaskHandle lcd_task_handle = NULL;
+
+static void lcd_task(void *pvParameters);
+#endif
+
+static bool lcd_state_command(uint8_t byte);
+static void lcd_state_data(uint8_t byte);
+static void lcd_set_address(uint8_t address);
+static void lcd_sync_address(void);
+
+#if defined(CONFIG_PANEL_LCD_ASYNC)
+static inline uint16_t ring_next(uint16_t i)
+{
+	return i + 1 == CONFIG_PANEL_LCD_RING_SIZE ? 0 : i + 1;
+}
+
+static uint16_t ring_depth(void)
+{
+	int depth = ring_head - ring_tail;
+	return depth < 0 ? depth + CONFIG_PANEL_LCD_RING_SIZE : depth;
+}
+
+/* The caller must hold ring_lock */
+static void ring_push(uint16_t entry)
+{
+	uint16_t next = ring_next(ring_head);
+
+	if (next == ring_tail) {
+		ring_overflows++;
+		xTaskNotifyGive(lcd_task_handle);
+		while (next == ring_tail) {
+			vTaskDelay(1);
+		}
+	}
+
+	ring[ring_head] = entry;
+	ring_head = next;
+
+	uint16_t depth = ring_depth();
+	if (depth > ring_max_depth) {
+		ring_max_depth = depth;
+	}
+}
+
+static void lcd_task(void *pvParameters)
+{
+	uint16_t *buf;
+	size_t len;
+
+	while (true) {
+		lcd_task_busy = false;
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		lcd_task_busy = true;
+
+		while (ring_tail != ring_head) {
+			/* Compose into the idle buffer while the other one is still
+			 * being sent */
+			buf = lcd_xfer_buffer();
+			len = 0;
+			while (len < LCD_XFER_FRAMES && ring_tail != ring_head &&
+					!(ring[ring_tail] & RING_BUSY)) {
+				buf[len++] = ring[ring_tail];
+				ring_tail = ring_next(ring_tail);
+			}
+			lcd_xfer_submit(len);
+
+			if (ring_tail != ring_head && (ring[ring_tail] & RING_BUSY)) {
+				lcd_busy((ring[ring_tail] & 0xFF) * RING_BUSY_UNIT_US);
+				ring_tail = ring_next(ring_tail);
+			}
+		}
+	}
+}
+
+static void lcd_out(uint8_t byte, bool command)
+{
+	xSemaphoreTake(ring_lock, portMAX_DELAY);
+	ring_push(byte | (command ? RING_COMMAND : 0));
+	xSemaphoreGive(ring_lock);
+	xTaskNotifyGive(lcd_task_handle);
+}
+
+static void lcd_out_buf(const uint8_t *buf, size_t len, bool command)
+{
+	xSemaphoreTake(ring_lock, portMAX_DELAY);
+	while (len--) {
+		ring_push(*buf++ | (command ? RING_COMMAND : 0));
+	}
+	xSemaphoreGive(ring_lock);
+	xTaskNotifyGive(lcd_task_handle);
+}
+
+static void lcd_out_busy(uint32_t us)
+{
+	xSemaphoreTake(ring_lock, portMAX_DELAY);
+	ring_push(RING_BUSY | (us + RING_BUSY_UNIT_US - 1) / RING_BUSY_UNIT_US);
+	xSemaphoreGive(ring_lock);
+	xTaskNotifyGive(lcd_task_handle);
+}
+
+void lcd_wait_idle(void)
+{
+	while (lcd_task_busy || ring_tail != ring_head) {
+		vTaskDelay(1);
+	}
+	lcd_xfer_wait();
+}
+
+void lcd_ring_get_stats(lcd_ring_stats_t *stats)
+{
+	stats->size = CONFIG_PANEL_LCD_RING_SIZE - 1;
+	stats->depth = ring_depth();
+	stats->max_depth = ring_max_depth;
+	stats->overflows = ring_overflows;
+}
+
+void lcd_ring_reset_stats(void)
+{
+	ring_max_depth = ring_depth();
+	ring_overflows = 0;
+}
+#else
+static void lcd_out(uint8_t byte, bool command)
+{
+	lcd_write(byte, command);
+}
+
+static void lcd_out_buf(const uint8_t *buf, size_t len, bool command)
+{
+	lcd_write_burst(buf, len, command);
+}
+
+static void lcd_out_busy(uint32_t us)
+{
+	lcd_busy(us);
+}
+
+void lcd_wait_idle(void)
+{
+	lcd_xfer_wait();
+}
+
+void lcd_ring_get_stats(lcd_ring_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+void lcd_ring_reset_stats(void)
+{
+}
+#endif
+
 void lcd_init(void)
 {
+#if defined(CONFIG_PANEL_LCD_ASYNC)
+	/* The bench runs this again to time it */
+	if (!lcd_task_handle) {
+		ring_lock = xSemaphoreCreateMutex();
+		xTaskCreate(lcd_task, "lcd", 1024, NULL, 1, &lcd_task_handle);
+	}
+#endif
+
 	lcd_command(0x38);
-	vTaskDelay(10 / portTICK_PERIOD_MS);
+	lcd_out_busy(LCD_INIT_US);
 	lcd_command(0x08);
 	lcd_command(0x01);
 	lcd_command(0x06);
 	lcd_command(0x0C);
 }
 
-void lcd_data(uint8_t byte)
+static inline uint8_t ddram_index(uint8_t address)
+{
+	return address < 40 ? address : address - 24;
+}
+
+static inline uint8_t ddram_address(uint8_t index)
+{
+	return index < 40 ? index : index + 24;
+}
+
+static void lcd_state_data(uint8_t byte)
 {
 	if (lcd_state.address_counter >= 0x80) { /* CGRAM */
 		lcd_state.cgram_data[lcd_state.address_counter & 0x3F] = byte;
@@ -80,18 +285,56 @@ void lcd_data(uint8_t byte)
 			}
 		}
 	}
+}
+
+void lcd_data(uint8_t byte)
+{
+	if (fb_active && fb_address < 0x80) {
+		fb_ddram[ddram_index(fb_address)] = byte;
+		fb_address++;
+		if (fb_address == 40) {
+			fb_address = 64;
+		} else if (fb_address == 104) {
+			fb_address = 0;
+		}
+		return;
+	}
+
+	lcd_sync_address();
+	lcd_state_data(byte);
+	lcd_out(byte, false);
 
-	lcd_write(byte, false);
+	if (fb_active) {
+		fb_address = lcd_state.address_counter;
+	}
 }
 
-void lcd_data_str(const uint8_t *s)
+void lcd_data_buf(const uint8_t *buf, size_t len)
 {
-	while (*s) {
-		lcd_data(*s++);
+	if (fb_active && fb_address < 0x80) {
+		while (len--) {
+			lcd_data(*buf++);
+		}
+		return;
+	}
+
+	lcd_sync_address();
+	for (size_t i = 0; i < len; i++) {
+		lcd_state_data(buf[i]);
+	}
+	lcd_out_buf(buf, len, false);
+
+	if (fb_active) {
+		fb_address = lcd_state.address_counter;
 	}
 }
 
-void lcd_command(uint8_t byte)
+void lcd_data_str(const uint8_t *s)
+{
+	lcd_data_buf(s, strlen((const char *)s));
+}
+
+static bool lcd_state_command(uint8_t byte)
 {
 	bool delay = false;
 
@@ -149,56 +392,263 @@ void lcd_command(uint8_t byte)
 		delay = true;
 	}
 
-	lcd_write(byte, true);
+	return delay;
+}
+
+void lcd_command(uint8_t byte)
+{
+	if (fb_active) {
+		if (byte & 0x80) { /* DDRAM address */
+			fb_address = byte & 0x7F;
+			if (fb_address > 39 && fb_address < 64) {
+				fb_address = 64;
+			} else if (fb_address > 104) {
+				fb_address = 0;
+			}
+			return;
+		} else if (byte == 0x01 && lcd_state.display_shift == 0) {
+			/* Clear display */
+			memset(fb_ddram, ' ', sizeof(fb_ddram));
+			fb_address = 0;
+			return;
+		} else if (byte == 0x02 && lcd_state.display_shift == 0) {
+			/* Return home */
+			fb_address = 0;
+			return;
+		}
+
+		lcd_fb_flush();
+	}
+
+	if (byte & 0xC0 || !(byte & 0xFC)) {
+		/* Address, clear and home commands all replace the address */
+		address_is_pending = false;
+	} else {
+		lcd_sync_address();
+	}
+
+	bool delay = lcd_state_command(byte);
+	lcd_out(byte, true);
 	if (delay) {
-		vTaskDelay(10 / portTICK_PERIOD_MS);
+		lcd_out_busy(LCD_SLOW_US);
+	}
+
+	if (fb_active) {
+		fb_address = lcd_state.address_counter;
+	}
+}
+
+void lcd_fb_begin(void)
+{
+	if (fb_depth++ > 0) {
+		return;
+	}
+
+	/* The diff relies on plain auto-increment, so leave the framebuffer
+	 * disabled for any other entry mode. */
+	if (!lcd_state.cursor_increase || lcd_state.display_scroll) {
+		return;
+	}
+
+	memcpy(fb_ddram, lcd_state.ddram_data, sizeof(fb_ddram));
+	fb_address = address_is_pending ? address_pending :
+			lcd_state.address_counter;
+	fb_active = true;
+}
+
+static void lcd_set_address(uint8_t address)
+{
+	uint8_t byte;
+
+	if (address >= 0x80) { /* CGRAM address */
+		byte = 0x40 | (address & 0x3F);
+	} else { /* DDRAM address */
+		byte = 0x80 | address;
 	}
+	lcd_state_command(byte);
+	lcd_out(byte, true);
+}
+
+static void lcd_sync_address(void)
+{
+	if (address_is_pending) {
+		address_is_pending = false;
+		if (lcd_state.address_counter != address_pending) {
+			lcd_set_address(address_pending);
+		}
+	}
+}
+
+/* Returns the end of the run of differing bytes starting at i.  The run is
+ * extended across single unchanged bytes, resending one byte costs the same
+ * as a new address command. */
+static int diff_run_end(const uint8_t *want, const uint8_t *have, int i,
+		int len)
+{
+	int end = i + 1;
+
+	while (end < len) {
+		if (want[end] != have[end]) {
+			end++;
+		} else if (end + 1 < len && want[end + 1] != have[end + 1]) {
+			end += 2;
+		} else {
+			break;
+		}
+	}
+
+	return end;
+}
+
+static void lcd_defer_address(uint8_t address)
+{
+	if (lcd_state.address_counter != address) {
+		address_pending = address;
+		address_is_pending = true;
+		if (lcd_state.cursor_on) {
+			lcd_sync_address();
+		}
+	} else {
+		address_is_pending = false;
+	}
+}
+
+void lcd_fb_flush(void)
+{
+	int i = 0;
+
+	if (!fb_active) {
+		return;
+	}
+
+	while (i < sizeof(fb_ddram)) {
+		if (fb_ddram[i] == lcd_state.ddram_data[i]) {
+			i++;
+			continue;
+		}
+
+		int end = diff_run_end(fb_ddram, lcd_state.ddram_data, i,
+				sizeof(fb_ddram));
+
+		if (lcd_state.address_counter != ddram_address(i)) {
+			lcd_set_address(ddram_address(i));
+		}
+
+		for (int j = i; j < end; j++) {
+			lcd_state_data(fb_ddram[j]);
+		}
+		lcd_out_buf(&fb_ddram[i], end - i, false);
+		i = end;
+	}
+
+	lcd_defer_address(fb_address);
+}
+
+void lcd_fb_end(void)
+{
+	if (fb_depth == 0 || --fb_depth > 0) {
+		return;
+	}
+
+	lcd_fb_flush();
+	fb_active = false;
+}
+
+/* Like an address command, but only sent ahead of the next write that needs
+ * it.  Addresses use the lcd_state_t encoding, CGRAM is 0x80 | offset. */
+void lcd_seek(uint8_t address)
+{
+	if (fb_active) {
+		fb_address = address;
+		if (address < 0x80) {
+			return;
+		}
+	}
+
+	lcd_defer_address(address);
+}
+
+const lcd_state_t *lcd_get_state(void)
+{
+	return &lcd_state;
+}
+
+uint8_t lcd_get_address(void)
+{
+	if (fb_active) {
+		return fb_address;
+	} else if (address_is_pending) {
+		return address_pending;
+	}
+	return lcd_state.address_counter;
 }
 
 void lcd_save(lcd_state_t *state)
 {
 	memcpy(state, &lcd_state, sizeof(lcd_state));
+	if (address_is_pending) {
+		state->address_counter = address_pending;
+	}
 }
 
+/* Brings the display back to a saved state, only sending what differs from
+ * the live shadow.  The display is not blanked, the writes happen with the
+ * cursor hidden and the final mode applied at the end. */
 void lcd_restore(lcd_state_t *state)
 {
-	int i;
+	int i, end;
 
-	memcpy(&lcd_state, state, sizeof(lcd_state));
+	if (lcd_state.cursor_on) {
+		lcd_command(0x08 | lcd_state.display_on << 2);
+	}
 
-	lcd_write(0x08, true); /* Turn off LCD */
+	/* The writes below rely on plain auto-increment */
+	if (!lcd_state.cursor_increase || lcd_state.display_scroll) {
+		lcd_command(0x06);
+	}
 
-	vTaskDelay(10 / portTICK_PERIOD_MS);
+	i = 0;
+	while (i < sizeof(lcd_state.cgram_data)) {
+		if (state->cgram_data[i] == lcd_state.cgram_data[i]) {
+			i++;
+			continue;
+		}
 
-	lcd_write(0x40, true); /* CGRAM addr 0 */
-	for (i = 0; i < sizeof(lcd_state.cgram_data); i++) {
-		lcd_write(lcd_state.cgram_data[i], false);
+		end = diff_run_end(state->cgram_data, lcd_state.cgram_data, i,
+				sizeof(lcd_state.cgram_data));
+		lcd_seek(0x80 | i);
+		lcd_data_buf(&state->cgram_data[i], end - i);
+		i = end;
 	}
 
-	lcd_write(0x80, true); /* DDRAM addr 0 */
-	for (i = 0; i < sizeof(lcd_state.ddram_data); i++) {
-		lcd_write(lcd_state.ddram_data[i], false);
-	}
+	lcd_fb_begin();
+	memcpy(fb_ddram, state->ddram_data, sizeof(fb_ddram));
+	lcd_fb_end();
 
-	if (lcd_state.display_shift < 20) {
-		for (i = 0; i < lcd_state.display_shift; i++) {
-			lcd_write(0x18, true); /* Shift display left */
+	/* Take the shorter way around the 40 column ring */
+	int shift = (state->display_shift - lcd_state.display_shift + 40) % 40;
+	if (shift <= 20) {
+		for (i = 0; i < shift; i++) {
+			lcd_command(0x18); /* Shift display left */
 		}
 	} else {
-		for (i = 39; i >= lcd_state.display_shift; i--) {
-			lcd_write(0x1C, true); /* Shift display right */
+		for (i = shift; i < 40; i++) {
+			lcd_command(0x1C); /* Shift display right */
 		}
 	}
 
-	if (lcd_state.address_counter >= 128) { /* CGRAM address */
-		lcd_write(0x40 | (lcd_state.address_counter & 0x3f), true);
-	} else { /* DDRAM address */
-		lcd_write(0x80 | lcd_state.address_counter, true);
+	if (state->cursor_increase != lcd_state.cursor_increase ||
+			state->display_scroll != lcd_state.display_scroll) {
+		lcd_command(0x04 | (state->cursor_increase << 1) |
+				state->display_scroll);
 	}
 
-	lcd_write(0x04 | (lcd_state.cursor_increase << 1) |
-			lcd_state.display_scroll, true);
+	if (state->display_on != lcd_state.display_on ||
+			state->cursor_on != lcd_state.cursor_on ||
+			state->cursor_blink != lcd_state.cursor_blink) {
+		lcd_command(0x08 | state->display_on << 2 |
+				state->cursor_on << 1 | state->cursor_blink);
+	}
 
-	lcd_write(0x08 | lcd_state.display_on << 2 |
-			lcd_state.cursor_on << 1 | lcd_state.cursor_blink, true);
+	lcd_seek(state->address_counter);
 }
@@ -1,6 +1,7 @@
 #ifndef _LCD_H
 #define _LCD_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct lcd_state_t {
@@ -15,11 +16,28 @@ typedef struct lcd_state_t {
 	uint8_t display_scroll : 1;
 } lcd_state_t;
 
+typedef struct lcd_ring_stats_t {
+	uint16_t size;
+	uint16_t depth;
+	uint16_t max_depth;
+	uint32_t overflows;
+} lcd_ring_stats_t;
+
 void lcd_init(void);
 void lcd_command(uint8_t byte);
 void lcd_data(uint8_t byte);
+void lcd_data_buf(const uint8_t *buf, size_t len);
 void lcd_data_str(const uint8_t *s);
+void lcd_fb_begin(void);
+void lcd_fb_flush(void);
+void lcd_fb_end(void);
+void lcd_seek(uint8_t address);
+const lcd_state_t *lcd_get_state(void);
+uint8_t lcd_get_address(void);
 void lcd_save(lcd_state_t *state);
 void lcd_restore(lcd_state_t *state);
+void lcd_wait_idle(void);
+void lcd_ring_get_stats(lcd_ring_stats_t *stats);
+void lcd_ring_reset_stats(void);
 
 #endif /* _LCD_H */
@@ -1,15 +1,22 @@
+#include <string.h>
+
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/timers.h>
 #include <freertos/semphr.h>
 
 #include <driver/gpio.h>
 #include <driver/hw_timer.h>
 #include <driver/spi.h>
+#include <esp_attr.h>
 #include <esp_err.h>
 #include <esp8266/gpio_register.h>
+#include <esp8266/gpio_struct.h>
 
 
+#include "hd44780.h"
 #include "panel.h"
+#include "panel_frame.h"
 
 
 #define WDEV_NOW() REG_READ(0x3ff20c00)
@@ -21,30 +28,131 @@
 #define GPIO_MISO 12
 #define GPIO_SCLK 14
 
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+# define SS_GUARD_US 1
+#elif defined(CONFIG_PANEL_TRANSPORT_SIM)
+# define SS_GUARD_US 0
+#else
+# define SS_GUARD_US 10
+#endif
+
+/* Waits longer than this sleep for whole ticks instead of spinning */
+#define LCD_BUSY_SPIN_US 2000
+
 static uint32_t buzzer_end;
 
 static xSemaphoreHandle spi_lock = NULL;
 
 static uint16_t leds = 0;
-static uint8_t loop_count = 0;
 
 static button_cb_t button_cb = NULL;
 volatile uint8_t buttons = 0;
 static xTimerHandle button_timer = NULL;
+static xQueueHandle button_queue = NULL;
+static xSemaphoreHandle button_synced = NULL;
 static uint8_t button_last_down = 0;
-static bool button_first_press = false;
+static uint32_t button_down_time;
+static button_repeat_t button_level = BUTTON_PRESS;
+static volatile bool wake_pending = false;
 
 static uint8_t contrast = 0x1f;
 
+static panel_stats_t stats;
+static uint32_t spi_lock_taken;
+static uint32_t lcd_busy_since;
+static uint32_t lcd_busy_us = 0;
+static uint32_t poll_last;
+static uint32_t poll_period_us;
+static uint8_t poll_unsettled = 0;
+static uint32_t poll_unsettled_since;
+
+#if defined(CONFIG_PANEL_TRANSPORT_SIM)
+static hd44780_t sim_lcd;
+static uint64_t sim_time = 0;
+static uint32_t sim_last = 0;
+#endif
+
+/* LCD transfer engine, xfer_fill is the buffer not owned by the ISR */
+static uint16_t xfer_buf[2][LCD_XFER_FRAMES];
+static uint8_t xfer_fill = 0;
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+static const uint16_t *volatile xfer_frames;
+static volatile size_t xfer_count;
+static volatile size_t xfer_pos;
+static volatile bool xfer_busy = false;
+static volatile xTaskHandle xfer_waiter = NULL;
+#endif
+
 static void buzzer_func(void* arg);
-static uint8_t poll_buttons(void);
+static uint8_t poll_buttons(uint32_t now);
 static void button_repeat_cb(xTimerHandle pxTimer);
 static void button_led_task(void *pvParameters);
+static void button_task(void *pvParameters);
+static void spi_xfer(int ss, uint32_t out, int bits, uint32_t *in);
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+static void spi_event_cb(int event, void *arg);
+#endif
 
-static void udelay(uint32_t t)
+static void IRAM_ATTR udelay(uint32_t t)
 {
 	uint32_t start = WDEV_NOW();
 	while (WDEV_NOW() - start < t);
+	stats.udelay_us += t;
+}
+
+static void spi_lock_take(void)
+{
+	uint32_t start = WDEV_NOW();
+	xSemaphoreTake(spi_lock, portMAX_DELAY);
+	spi_lock_taken = WDEV_NOW();
+	stats.lock_wait_us += spi_lock_taken - start;
+}
+
+static void spi_lock_give(void)
+{
+	uint32_t held = WDEV_NOW() - spi_lock_taken;
+	if (held > stats.lock_hold_max_us) {
+		stats.lock_hold_max_us = held;
+	}
+	xSemaphoreGive(spi_lock);
+}
+
+static void count_lcd_frames(size_t count, bool command)
+{
+	stats.lcd_frames += count;
+	if (command) {
+		stats.lcd_commands += count;
+	} else {
+		stats.lcd_data += count;
+	}
+}
+
+/* Holds back the next LCD frame until the last slow command has had its
+ * execution time, counted from when that command reached the controller. */
+static void lcd_busy_wait(void)
+{
+	const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+	uint32_t start = WDEV_NOW();
+	uint32_t elapsed = start - lcd_busy_since;
+
+	if (elapsed >= lcd_busy_us) {
+		lcd_busy_us = 0;
+		return;
+	}
+
+	while (elapsed < lcd_busy_us) {
+		uint32_t left = lcd_busy_us - elapsed;
+		if (left > LCD_BUSY_SPIN_US) {
+			vTaskDelay(left / tick_us + 1);
+		} else {
+			udelay(left);
+		}
+		elapsed = WDEV_NOW() - lcd_busy_since;
+	}
+	lcd_busy_us = 0;
+
+	stats.lcd_busy_waits++;
+	stats.lcd_busy_wait_us += WDEV_NOW() - start;
 }
 
 void panel_init(void)
@@ -62,6 +170,27 @@ void panel_init(void)
     gpio_set_level(GPIO_SS0, 1);
 	gpio_set_level(GPIO_SS1, 1);
 
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+	/* Both selects stay GPIOs, the hardware CS would also frame SS1 cycles */
+	gpio_config_t config = {
+		.mode = GPIO_MODE_OUTPUT,
+		.pin_bit_mask = 1<<GPIO_SS0 | 1<<GPIO_SS1,
+	};
+	gpio_config(&config);
+
+	spi_config_t spi_config = {
+		.interface.val = SPI_DEFAULT_INTERFACE,
+		.intr_enable.val = SPI_MASTER_DEFAULT_INTR_ENABLE,
+		.event_cb = spi_event_cb,
+		.mode = SPI_MASTER_MODE,
+		.clk_div = CONFIG_PANEL_HSPI_CLK_DIV,
+	};
+	spi_config.interface.cs_en = 0;
+	ESP_ERROR_CHECK(spi_init(HSPI_HOST, &spi_config));
+#elif defined(CONFIG_PANEL_TRANSPORT_SIM)
+	hd44780_init(&sim_lcd, CONFIG_PANEL_SIM_FRAME_US);
+	sim_last = WDEV_NOW();
+#else
 	gpio_config_t config = {
 		.mode = GPIO_MODE_OUTPUT,
 		.pin_bit_mask = 1<<GPIO_SS0 | 1<<GPIO_SS1 | 1<<GPIO_MOSI | 1<<GPIO_SCLK,
@@ -71,14 +200,18 @@ void panel_init(void)
 	config.mode = GPIO_MODE_INPUT;
 	config.pin_bit_mask = 1<<GPIO_MISO;
 	gpio_config(&config);
+#endif
 
 	spi_lock = xSemaphoreCreateMutex();
 
 	/* Buttons/LEDs */
 	backlight_set(true);
-	poll_buttons();
+	poll_buttons(WDEV_NOW());
+	button_queue = xQueueCreate(BUTTON_QUEUE_LEN, sizeof(button_event_t));
+	button_synced = xSemaphoreCreateBinary();
 	xTaskCreate(button_led_task, "panel", 2048, NULL, 2, NULL);
-	button_timer = xTimerCreate("button", 250 / portTICK_PERIOD_MS, pdTRUE, NULL, button_repeat_cb);
+	xTaskCreate(button_task, "button", 2048, NULL, 2, NULL);
+	button_timer = xTimerCreate("button", CONFIG_PANEL_REPEAT_DELAY_MS / portTICK_PERIOD_MS, pdFALSE, NULL, button_repeat_cb);
 }
 
 static void buzzer_func(void* arg)
@@ -103,7 +236,12 @@ void buzzer_play(uint32_t frequency, uint32_t duration)
 	}
 }
 
-static uint8_t leds_get_raw(void)
+/* Blink phases come from the microsecond timer, so they don't depend on how
+ * often the shift register is polled.  Slow is ~1 s on/off, fast ~130 ms. */
+#define LED_SLOW_BIT BIT(20)
+#define LED_FAST_BIT BIT(17)
+
+static uint8_t leds_get_raw(uint32_t now)
 {
 	uint8_t raw = 0xff;
 
@@ -114,7 +252,7 @@ static uint8_t leds_get_raw(void)
 			break;
 
 		case LED_SLOW:
-			if (loop_count & 128) {
+			if (now & LED_SLOW_BIT) {
 				raw &= ~(1 << led);
 			} else {
 				raw |= 1 << led;
@@ -122,7 +260,7 @@ static uint8_t leds_get_raw(void)
 			break;
 
 		case LED_FAST:
-			if (loop_count & 16) {
+			if (now & LED_FAST_BIT) {
 				raw &= ~(1 << led);
 			} else {
 				raw |= 1 << led;
@@ -138,6 +276,27 @@ static uint8_t leds_get_raw(void)
 	return raw;
 }
 
+/* Microseconds until a blinking LED changes, or UINT32_MAX if none blink */
+static uint32_t leds_next_change(uint32_t now)
+{
+	uint32_t bit = 0;
+
+	for (led_t led = LED_BACKLIGHT; led <= LED_7; led++) {
+		led_state_t state = (leds >> (led * 2)) & 0x03;
+		if (state == LED_FAST) {
+			bit = LED_FAST_BIT;
+			break;
+		} else if (state == LED_SLOW) {
+			bit = LED_SLOW_BIT;
+		}
+	}
+
+	if (!bit) {
+		return UINT32_MAX;
+	}
+	return bit - (now & (bit - 1));
+}
+
 void led_set(led_t led, led_state_t state)
 {
 	leds &= ~(0x03 << (led * 2));
@@ -154,6 +313,104 @@ void backlight_set(bool enabled)
 	led_set(LED_BACKLIGHT, enabled ? LED_ON : LED_OFF);
 }
 
+/* Returns false when the queue stayed full for `wait` ticks */
+static bool button_post(button_t button, bool down, button_repeat_t repeat,
+		TickType_t wait)
+{
+	button_event_t event = {
+		.button = button,
+		.down = down,
+		.repeat = repeat,
+		.time = WDEV_NOW(),
+	};
+
+	return xQueueSend(button_queue, &event, wait) == pdTRUE;
+}
+
+/* Lets the button callback know that something it shows changed, it is
+ * called with BTN_NONE from the button task.  A wake still waiting anywhere
+ * in the queue covers this one too.  The button task clears wake_pending
+ * before it runs the callback, so a change made while the callback runs
+ * gets a wake of its own. */
+void button_wake(void)
+{
+	if (wake_pending) {
+		return;
+	}
+	wake_pending = true;
+	/* Never blocks, as the dialog timers wake from the timer task.  A wake
+	 * that finds the queue full is dropped, the callback is about to run
+	 * for the events ahead of it anyway. */
+	if (!button_post(BTN_NONE, true, BUTTON_PRESS, 0)) {
+		wake_pending = false;
+	}
+}
+
+/* Queues a key event as if it came from the keypad, for driving the panel
+ * from code such as the bench */
+void button_send(button_t button, bool down)
+{
+	button_post(button, down, BUTTON_PRESS, portMAX_DELAY);
+}
+
+/* Waits until the events queued before it were delivered.  A release of
+ * BTN_NONE, which nothing else sends, marks the spot in the queue and the
+ * button task answers it instead of calling the callback. */
+void button_sync(void)
+{
+	button_post(BTN_NONE, false, BUTTON_PRESS, portMAX_DELAY);
+	xSemaphoreTake(button_synced, portMAX_DELAY);
+}
+
+/* Delivers queued events one at a time, so button_cb never runs in two
+ * contexts at once. */
+static void button_task(void *pvParameters)
+{
+	button_event_t event;
+
+	while (true) {
+		xQueueReceive(button_queue, &event, portMAX_DELAY);
+		if (event.button == BTN_NONE && !event.down) {
+			xSemaphoreGive(button_synced);
+			continue;
+		}
+		if (event.button == BTN_NONE) {
+			wake_pending = false;
+		}
+		button_level = event.repeat;
+		if (button_cb) {
+			button_cb(event.button, event.down, event.time);
+		}
+	}
+}
+
+/* Called from a button callback, removes the auto-repeats of the same button
+ * that are queued next and returns how many there were. */
+uint8_t button_coalesce(button_t button)
+{
+	button_event_t event;
+	uint8_t count = 0;
+
+	while (count < UINT8_MAX && xQueuePeek(button_queue, &event, 0) == pdTRUE &&
+			event.button == button && event.repeat) {
+		xQueueReceive(button_queue, &event, 0);
+		if (event.repeat > button_level) {
+			button_level = event.repeat;
+		}
+		count++;
+	}
+	stats.coalesced += count;
+
+	return count;
+}
+
+/* Repeat level of the event being delivered, or of the fastest repeat that
+ * button_coalesce() merged into it */
+button_repeat_t button_repeat_level(void)
+{
+	return button_level;
+}
+
 void button_set_cb(button_cb_t cb)
 {
 	button_cb = cb;
@@ -164,20 +421,201 @@ button_cb_t button_get_cb()
 	return button_cb;
 }
 
-static uint8_t poll_buttons(void)
+static inline uint16_t IRAM_ATTR lcd_frame(uint8_t byte, bool command)
 {
-	static uint8_t cnt0, cnt1;
-	static bool first = true;
-	uint8_t sample = 0;
-	uint8_t delta, toggle;
+	return panel_lcd_frame(byte, command, contrast);
+}
 
-	uint8_t leds = leds_get_raw();
-	xSemaphoreTake(spi_lock, portMAX_DELAY);
-	gpio_set_level(GPIO_SS1, 0);
-	udelay(10);
-	for (int i = 0; i < 8; i++) {
-		gpio_set_level(GPIO_MOSI, leds & 0x80);
-		leds <<= 1;
+static uint16_t contrast_frame(void)
+{
+	return panel_contrast_frame(contrast);
+}
+
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+/* Blocks until the transfer engine has sent its last frame.  Callers hold
+ * spi_lock, which keeps this the only waiter. */
+static void xfer_wait_idle(void)
+{
+	portENTER_CRITICAL();
+	xfer_waiter = xTaskGetCurrentTaskHandle();
+	portEXIT_CRITICAL();
+
+	while (xfer_busy) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+	xfer_waiter = NULL;
+}
+
+static void IRAM_ATTR xfer_start_frame(void)
+{
+	static uint32_t mosi;
+	static spi_trans_t trans = {
+		.mosi = &mosi,
+		.bits.mosi = 16,
+	};
+
+	uint16_t entry = xfer_frames[xfer_pos];
+	uint16_t frame = lcd_frame(entry & 0xFF, entry & LCD_XFER_COMMAND);
+	mosi = panel_hspi_pack(frame, 16);
+	spi_trans(HSPI_HOST, &trans);
+}
+
+static void IRAM_ATTR spi_event_cb(int event, void *arg)
+{
+	if (event != SPI_TRANS_DONE_EVENT || !xfer_busy) {
+		return;
+	}
+
+	udelay(SS_GUARD_US);
+	GPIO.out_w1ts = BIT(GPIO_SS0);
+	udelay(SS_GUARD_US);
+
+	if (++xfer_pos < xfer_count) {
+		GPIO.out_w1tc = BIT(GPIO_SS0);
+		udelay(SS_GUARD_US);
+		xfer_start_frame();
+		return;
+	}
+
+	BaseType_t woken = pdFALSE;
+	xfer_busy = false;
+	if (xfer_waiter) {
+		vTaskNotifyGiveFromISR(xfer_waiter, &woken);
+	}
+	if (woken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+uint16_t *lcd_xfer_buffer(void)
+{
+	return xfer_buf[xfer_fill];
+}
+
+void lcd_xfer_submit(size_t count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	lcd_busy_wait();
+	spi_lock_take();
+	xfer_wait_idle();
+	for (size_t i = 0; i < count; i++) {
+		count_lcd_frames(1, xfer_buf[xfer_fill][i] & LCD_XFER_COMMAND);
+	}
+	xfer_frames = xfer_buf[xfer_fill];
+	xfer_count = count;
+	xfer_pos = 0;
+	xfer_busy = true;
+	xfer_fill ^= 1;
+
+	gpio_set_level(GPIO_SS0, 0);
+	udelay(SS_GUARD_US);
+	xfer_start_frame();
+	spi_lock_give();
+}
+
+bool lcd_xfer_poll(void)
+{
+	return !xfer_busy;
+}
+
+void lcd_xfer_wait(void)
+{
+	spi_lock_take();
+	xfer_wait_idle();
+	spi_lock_give();
+}
+#else
+uint16_t *lcd_xfer_buffer(void)
+{
+	return xfer_buf[xfer_fill];
+}
+
+void lcd_xfer_submit(size_t count)
+{
+	lcd_busy_wait();
+	spi_lock_take();
+	for (size_t i = 0; i < count; i++) {
+		uint16_t entry = xfer_buf[xfer_fill][i];
+		count_lcd_frames(1, entry & LCD_XFER_COMMAND);
+		spi_xfer(GPIO_SS0, lcd_frame(entry & 0xFF, entry & LCD_XFER_COMMAND),
+				16, NULL);
+	}
+	spi_lock_give();
+}
+
+bool lcd_xfer_poll(void)
+{
+	return true;
+}
+
+void lcd_xfer_wait(void)
+{
+}
+#endif
+
+/* Clocks out the low `bits` of `out` MSB first with `ss` held low, sampling
+ * MISO into `in` when it is non-NULL.  The caller must hold spi_lock. */
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+static void spi_xfer(int ss, uint32_t out, int bits, uint32_t *in)
+{
+	uint32_t mosi, miso = 0;
+
+	xfer_wait_idle();
+
+	mosi = panel_hspi_pack(out, bits);
+
+	/* Always clock MISO in too, which makes spi_trans() wait for the end
+	 * of the transfer before the select is released */
+	spi_trans_t trans = {
+		.mosi = &mosi,
+		.miso = &miso,
+		.bits.mosi = bits,
+		.bits.miso = bits,
+	};
+
+	gpio_set_level(ss, 0);
+	udelay(SS_GUARD_US);
+	spi_trans(HSPI_HOST, &trans);
+	udelay(SS_GUARD_US);
+	gpio_set_level(ss, 1);
+	udelay(SS_GUARD_US);
+
+	if (in) {
+		*in = panel_hspi_unpack(miso, bits);
+	}
+}
+#elif defined(CONFIG_PANEL_TRANSPORT_SIM)
+static void spi_xfer(int ss, uint32_t out, int bits, uint32_t *in)
+{
+	uint32_t now = WDEV_NOW();
+
+	sim_time += now - sim_last;
+	sim_last = now;
+
+	/* Only LCD frames reach the model, contrast frames have bit 15 clear */
+	if (ss == GPIO_SS0 && (out & PANEL_FRAME_STROBE)) {
+		hd44780_write(&sim_lcd, out & 0xFF, out & PANEL_FRAME_DATA, sim_time);
+		/* Take as long as the simulated bus does, so that lcd_busy()
+		 * waits timed with WDEV_NOW() line up with the model */
+		udelay(sim_lcd.bus_free - sim_time);
+	}
+
+	if (in) {
+		*in = 0;
+	}
+}
+#else
+static void spi_xfer(int ss, uint32_t out, int bits, uint32_t *in)
+{
+	uint32_t sample = 0;
+
+	gpio_set_level(ss, 0);
+	udelay(SS_GUARD_US);
+	for (int i = bits - 1; i >= 0; i--) {
+		gpio_set_level(GPIO_MOSI, (out >> i) & 1);
 		udelay(10);
 		sample <<= 1;
 		sample |= gpio_get_level(GPIO_MISO);
@@ -185,12 +623,30 @@ static uint8_t poll_buttons(void)
 		udelay(10);
 		gpio_set_level(GPIO_SCLK, 0);
 	}
-	udelay(10);
-	gpio_set_level(GPIO_SS1, 1);
-	udelay(10);
-	xSemaphoreGive(spi_lock);
+	udelay(SS_GUARD_US);
+	gpio_set_level(ss, 1);
+	udelay(SS_GUARD_US);
 
-	sample >>= 3;
+	if (in) {
+		*in = sample;
+	}
+}
+#endif
+
+static uint8_t poll_buttons(uint32_t now)
+{
+	static uint8_t cnt0, cnt1;
+	static bool first = true;
+	uint32_t sample;
+	uint8_t delta, toggle;
+
+	uint8_t leds = leds_get_raw(now);
+	spi_lock_take();
+	spi_xfer(GPIO_SS1, leds, 8, &sample);
+	spi_lock_give();
+
+	sample = (sample & 0xFF) >> 3;
+	stats.polls++;
 
 	if (first) {
 		toggle = 0;
@@ -203,94 +659,184 @@ static uint8_t poll_buttons(void)
 		cnt0 = ~cnt0 & delta;
 		toggle = delta & ~(cnt0 | cnt1);
 		buttons ^= toggle;
+		stats.debounce_toggles += __builtin_popcount(toggle);
+
+		/* A press happened somewhere after the last quiet sample, that
+		 * bounds how long it took to report */
+		if (delta && !poll_unsettled) {
+			poll_unsettled_since = poll_last;
+		}
+		poll_unsettled = delta & ~toggle;
+		if (toggle & buttons) {
+			uint32_t latency = now - poll_unsettled_since;
+			if (latency > stats.press_latency_max_us) {
+				stats.press_latency_max_us = latency;
+			}
+		}
 	}
 
 	return toggle;
 }
 
+/* Polls fast while buttons are down, bouncing or were recently used, and at
+ * the idle period otherwise, cut short when a blinking LED is due. */
 static void button_led_task(void *pvParameters)
 {
 	uint8_t toggle;
+	uint32_t active_last;
+
+	poll_last = WDEV_NOW();
+	active_last = poll_last;
+	poll_period_us = CONFIG_PANEL_POLL_FAST_MS * 1000;
 
 	while (true) {
-		toggle = poll_buttons();
+		/* An overrun is a poll that came more than a tick late */
+		uint32_t now = WDEV_NOW();
+		if (now - poll_last > poll_period_us + portTICK_PERIOD_MS * 1000) {
+			stats.poll_overruns++;
+		}
 
-		if (button_cb) {
-			for (int n = BTN_UP; n <= BTN_ENTER; n++) {
-				if (toggle & BIT(n)) {
-					if (buttons & BIT(n)) {
-						button_last_down = n;
-						xTimerChangePeriod(button_timer, 250 / portTICK_PERIOD_MS, portMAX_DELAY);
-						xTimerStart(button_timer, portMAX_DELAY);
-						button_first_press = true;
-					} else if (button_last_down == n) {
-						xTimerStop(button_timer, portMAX_DELAY);
-					}
-					button_cb(n, !!(buttons & BIT(n)), WDEV_NOW());
+		toggle = poll_buttons(now);
+		poll_last = now;
+
+		for (int n = BTN_UP; n <= BTN_ENTER; n++) {
+			if (toggle & BIT(n)) {
+				if (buttons & BIT(n)) {
+					button_last_down = n;
+					button_down_time = now;
+					xTimerChangePeriod(button_timer, CONFIG_PANEL_REPEAT_DELAY_MS / portTICK_PERIOD_MS, portMAX_DELAY);
+					xTimerStart(button_timer, portMAX_DELAY);
+				} else if (button_last_down == n) {
+					xTimerStop(button_timer, portMAX_DELAY);
 				}
+				button_post(n, !!(buttons & BIT(n)), BUTTON_PRESS,
+						portMAX_DELAY);
 			}
 		}
-		vTaskDelay(10 / portTICK_PERIOD_MS);
-		loop_count++;
+
+		if (buttons || poll_unsettled || toggle) {
+			active_last = now;
+		}
+
+		if (now - active_last < CONFIG_PANEL_POLL_IDLE_AFTER_MS * 1000) {
+			poll_period_us = CONFIG_PANEL_POLL_FAST_MS * 1000;
+		} else {
+			poll_period_us = CONFIG_PANEL_POLL_IDLE_MS * 1000;
+			uint32_t blink = leds_next_change(now);
+			if (blink < poll_period_us) {
+				poll_period_us = blink;
+			}
+			stats.idle_polls++;
+		}
+
+		const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+		uint32_t ticks = (poll_period_us + tick_us - 1) / tick_us;
+		vTaskDelay(ticks ? ticks : 1);
 	}
 }
 
+/* The repeat period ramps linearly from PANEL_REPEAT_START_MS to
+ * PANEL_REPEAT_MIN_MS over PANEL_REPEAT_RAMP_MS of repeating */
 static void button_repeat_cb(xTimerHandle pxTimer)
 {
-	if (button_first_press) {
-		xTimerChangePeriod(button_timer, 100 / portTICK_PERIOD_MS, portMAX_DELAY);
-		button_first_press = false;
+	uint32_t period = CONFIG_PANEL_REPEAT_START_MS;
+	button_repeat_t level = BUTTON_REPEAT;
+
+	/* Released while this callback was already due */
+	if (!(buttons & BIT(button_last_down))) {
+		return;
 	}
-	if (button_cb) {
-		button_cb(button_last_down, true, WDEV_NOW());
+
+	if (CONFIG_PANEL_REPEAT_RAMP_MS > 0) {
+		uint32_t held = (WDEV_NOW() - button_down_time) / 1000;
+		uint32_t ramp = held > CONFIG_PANEL_REPEAT_DELAY_MS ?
+				held - CONFIG_PANEL_REPEAT_DELAY_MS : 0;
+		if (ramp >= CONFIG_PANEL_REPEAT_RAMP_MS) {
+			period = CONFIG_PANEL_REPEAT_MIN_MS;
+			level = BUTTON_REPEAT_FAST;
+		} else {
+			period -= (CONFIG_PANEL_REPEAT_START_MS - CONFIG_PANEL_REPEAT_MIN_MS) *
+					ramp / CONFIG_PANEL_REPEAT_RAMP_MS;
+		}
 	}
+
+	uint32_t ticks = period / portTICK_PERIOD_MS;
+	xTimerChangePeriod(button_timer, ticks ? ticks : 1, 0);
+
+	stats.repeats++;
+	/* Repeats can be dropped, their key is still down */
+	if (!button_post(button_last_down, true, level, 0)) {
+		stats.event_drops++;
+	}
+}
+
+/* Marks the controller busy for `us` once the frames already handed over have
+ * been sent, the next LCD frame waits out whatever is left of it. */
+void lcd_busy(uint32_t us)
+{
+	spi_lock_take();
+#if defined(CONFIG_PANEL_TRANSPORT_HSPI)
+	xfer_wait_idle();
+#endif
+	lcd_busy_since = WDEV_NOW();
+	lcd_busy_us = us;
+	spi_lock_give();
 }
 
 void lcd_write(uint8_t byte, bool command)
 {
-	xSemaphoreTake(spi_lock, portMAX_DELAY);
-	gpio_set_level(GPIO_SS0, false);
-	udelay(10);
-	uint32_t data = 0x8000 | (~contrast & 0x1f) << 10 | byte;
-	if (!command) {
-		data |= 0x0100;
-	}
-	for (int i = 0; i < 16; i++) {
-		gpio_set_level(GPIO_MOSI, data & 0x8000);
-		data <<= 1;
-		udelay(10);
-		gpio_set_level(GPIO_SCLK, 1);
-		udelay(10);
-		gpio_set_level(GPIO_SCLK, 0);
+	lcd_busy_wait();
+	spi_lock_take();
+	count_lcd_frames(1, command);
+	spi_xfer(GPIO_SS0, lcd_frame(byte, command), 16, NULL);
+	spi_lock_give();
+}
+
+void lcd_write_burst(const uint8_t *bytes, size_t len, bool command)
+{
+	lcd_busy_wait();
+	spi_lock_take();
+	count_lcd_frames(len, command);
+	for (size_t i = 0; i < len; i++) {
+		spi_xfer(GPIO_SS0, lcd_frame(bytes[i], command), 16, NULL);
 	}
-	udelay(10);
-	gpio_set_level(GPIO_SS0, true);
-	udelay(10);
-	xSemaphoreGive(spi_lock);
+	spi_lock_give();
 }
 
 void set_contrast(uint8_t n)
 {
 	contrast = n;
-	xSemaphoreTake(spi_lock, portMAX_DELAY);
-	gpio_set_level(GPIO_SS0, false);
-	udelay(10);
-	uint32_t data = 0x0000 | (~contrast & 0x1f) << 10;
-	for (int i = 0; i < 16; i++) {
-		gpio_set_level(GPIO_MOSI, data & 0x8000);
-		data <<= 1;
-		udelay(10);
-		gpio_set_level(GPIO_SCLK, 1);
-		udelay(10);
-		gpio_set_level(GPIO_SCLK, 0);
-	}
-	udelay(10);
-	gpio_set_level(GPIO_SS0, true);
-	udelay(10);
-	xSemaphoreGive(spi_lock);
+	spi_lock_take();
+	spi_xfer(GPIO_SS0, contrast_frame(), 16, NULL);
+	spi_lock_give();
 }
 
 uint8_t get_contrast(void)
 {
 	return contrast;
 }
+
+void panel_get_stats(panel_stats_t *out)
+{
+	*out = stats;
+}
+
+void panel_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/* The free running microsecond counter everything in the panel is timed by */
+uint32_t panel_time_us(void)
+{
+	return WDEV_NOW();
+}
+
+hd44780_t *panel_sim_lcd(void)
+{
+#if defined(CONFIG_PANEL_TRANSPORT_SIM)
+	return &sim_lcd;
+#else
+	return NULL;
+#endif
+}
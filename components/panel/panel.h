@@ -2,17 +2,54 @@
 #define PANEL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "hd44780.h"
+
 
 #define PANEL_LCD_ROWS 2
 #define PANEL_LCD_COLS 40
 
+#define LCD_XFER_FRAMES 64
+#define LCD_XFER_COMMAND 0x0100
+
 typedef enum {LED_BACKLIGHT, LED_1, LED_2, LED_3, LED_4, LED_5, LED_6, LED_7} led_t;
 typedef enum {LED_OFF, LED_SLOW, LED_FAST, LED_ON} led_state_t;
-typedef enum {BTN_UP, BTN_DOWN, BTN_LEFT, BTN_RIGHT, BTN_ENTER} button_t;
+/* BTN_NONE events come from button_wake(), not from a key */
+typedef enum {BTN_UP, BTN_DOWN, BTN_LEFT, BTN_RIGHT, BTN_ENTER, BTN_NONE} button_t;
 typedef void (*button_cb_t)(button_t button, bool down, uint32_t time);
 
+#define BUTTON_QUEUE_LEN 16
+
+typedef enum {BUTTON_PRESS, BUTTON_REPEAT, BUTTON_REPEAT_FAST} button_repeat_t;
+
+typedef struct button_event_t {
+	button_t button;
+	bool down;
+	button_repeat_t repeat;
+	uint32_t time; /* WDEV_NOW() when the edge was debounced */
+} button_event_t;
+
+typedef struct panel_stats_t {
+	uint32_t lcd_frames;
+	uint32_t lcd_data;
+	uint32_t lcd_commands;
+	uint32_t udelay_us;
+	uint32_t lock_wait_us;
+	uint32_t lock_hold_max_us;
+	uint32_t lcd_busy_waits;
+	uint32_t lcd_busy_wait_us;
+	uint32_t polls;
+	uint32_t idle_polls;
+	uint32_t poll_overruns;
+	uint32_t press_latency_max_us;
+	uint32_t debounce_toggles;
+	uint32_t repeats;
+	uint32_t coalesced;
+	uint32_t event_drops;
+} panel_stats_t;
+
 void panel_init(void);
 
 void buzzer_play(uint32_t frequency, uint32_t duration);
@@ -23,9 +60,25 @@ void backlight_set(bool enabled);
 
 void button_set_cb(button_cb_t);
 button_cb_t button_get_cb(void);
+uint8_t button_coalesce(button_t button);
+void button_wake(void);
+void button_send(button_t button, bool down);
+void button_sync(void);
+button_repeat_t button_repeat_level(void);
 
+void lcd_busy(uint32_t us);
 void lcd_write(uint8_t byte, bool command);
+void lcd_write_burst(const uint8_t *bytes, size_t len, bool command);
+uint16_t *lcd_xfer_buffer(void);
+void lcd_xfer_submit(size_t count);
+bool lcd_xfer_poll(void);
+void lcd_xfer_wait(void);
 void set_contrast(uint8_t contrast);
 uint8_t get_contrast(void);
 
+void panel_get_stats(panel_stats_t *stats);
+void panel_reset_stats(void);
+hd44780_t *panel_sim_lcd(void);
+uint32_t panel_time_us(void);
+
 #endif /* PANEL_H */
@@ -0,0 +1,56 @@
+#ifndef _PANEL_FRAME_H
+#define _PANEL_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Wire format of the panel shift registers, kept free of ESP headers so the
+ * host tests can check it.  Frames go out MSB first.  On SS0 the 16-bit
+ * frame is: bit 15 strobes the LCD, bits 14-10 are the inverted contrast,
+ * bit 8 is RS (set for data) and bits 7-0 the LCD byte. */
+
+#define PANEL_FRAME_STROBE 0x8000
+#define PANEL_FRAME_DATA 0x0100
+
+static inline __attribute__((always_inline))
+uint16_t panel_lcd_frame(uint8_t byte, bool command, uint8_t contrast)
+{
+	uint16_t frame = PANEL_FRAME_STROBE | (~contrast & 0x1f) << 10 | byte;
+	if (!command) {
+		frame |= PANEL_FRAME_DATA;
+	}
+	return frame;
+}
+
+/* Only updates the contrast DAC, the LCD ignores frames without a strobe */
+static inline __attribute__((always_inline))
+uint16_t panel_contrast_frame(uint8_t contrast)
+{
+	return (~contrast & 0x1f) << 10;
+}
+
+/* The HSPI FIFO sends data_buf byte 0 first, so a frame of `bits` bits is
+ * stored with its bytes reversed */
+static inline __attribute__((always_inline))
+uint32_t panel_hspi_pack(uint32_t out, int bits)
+{
+	uint32_t word = 0;
+
+	for (int i = 0; i < bits; i += 8) {
+		word |= ((out >> (bits - 8 - i)) & 0xFF) << i;
+	}
+	return word;
+}
+
+static inline __attribute__((always_inline))
+uint32_t panel_hspi_unpack(uint32_t word, int bits)
+{
+	uint32_t in = 0;
+
+	for (int i = 0; i < bits; i += 8) {
+		in |= ((word >> i) & 0xFF) << (bits - 8 - i);
+	}
+	return in;
+}
+
+#endif /* _PANEL_FRAME_H */
@@ -0,0 +1,115 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dialog.h"
+#include "glyph.h"
+#include "lcd.h"
+#include "panel.h"
+#include "stats.h"
+
+enum {
+	ROW_FRAMES,
+	ROW_SPLIT,
+	ROW_UDELAY,
+	ROW_BUSY,
+	ROW_LOCK_WAIT,
+	ROW_LOCK_HOLD,
+	ROW_POLLS,
+	ROW_LATENCY,
+	ROW_OVERRUNS,
+	ROW_TOGGLES,
+	ROW_REPEATS,
+	ROW_RING,
+	ROW_GLYPHS,
+	ROW_DIALOGS,
+	ROW_COUNT,
+};
+
+static char values[ROW_COUNT][PANEL_LCD_COLS / 2 + 1];
+
+static void stats_update(view_t *view)
+{
+	panel_stats_t stats;
+	lcd_ring_stats_t ring;
+	glyph_stats_t glyphs;
+	dialog_stats_t dialogs;
+
+	panel_get_stats(&stats);
+	lcd_ring_get_stats(&ring);
+	glyph_get_stats(&glyphs);
+	dialog_get_stats(&dialogs);
+
+	snprintf(values[ROW_FRAMES], sizeof(values[0]), "%" PRIu32,
+			stats.lcd_frames);
+	snprintf(values[ROW_SPLIT], sizeof(values[0]), "%" PRIu32 "/%" PRIu32,
+			stats.lcd_data, stats.lcd_commands);
+	snprintf(values[ROW_UDELAY], sizeof(values[0]), "%" PRIu32 " ms",
+			stats.udelay_us / 1000);
+	snprintf(values[ROW_BUSY], sizeof(values[0]), "%" PRIu32 "/%" PRIu32 " ms",
+			stats.lcd_busy_waits, stats.lcd_busy_wait_us / 1000);
+	snprintf(values[ROW_LOCK_WAIT], sizeof(values[0]), "%" PRIu32 " ms",
+			stats.lock_wait_us / 1000);
+	snprintf(values[ROW_LOCK_HOLD], sizeof(values[0]), "%" PRIu32 " us",
+			stats.lock_hold_max_us);
+	snprintf(values[ROW_POLLS], sizeof(values[0]), "%" PRIu32 "/%" PRIu32,
+			stats.polls, stats.idle_polls);
+	snprintf(values[ROW_LATENCY], sizeof(values[0]), "%" PRIu32 " ms",
+			stats.press_latency_max_us / 1000);
+	snprintf(values[ROW_OVERRUNS], sizeof(values[0]), "%" PRIu32,
+			stats.poll_overruns);
+	snprintf(values[ROW_TOGGLES], sizeof(values[0]), "%" PRIu32,
+			stats.debounce_toggles);
+	snprintf(values[ROW_REPEATS], sizeof(values[0]),
+			"%" PRIu32 "/%" PRIu32 "/%" PRIu32, stats.repeats, stats.coalesced,
+			stats.event_drops);
+	snprintf(values[ROW_RING], sizeof(values[0]), "%u/%" PRIu32,
+			ring.max_depth, ring.overflows);
+	snprintf(values[ROW_GLYPHS], sizeof(values[0]),
+			"%" PRIu32 "/%" PRIu32 "/%" PRIu32, glyphs.hits, glyphs.misses,
+			glyphs.evictions);
+	snprintf(values[ROW_DIALOGS], sizeof(values[0]), "%u/%u/%" PRIu32,
+			dialogs.arena_used, dialogs.arena_peak, dialogs.heap_fallbacks);
+}
+
+static void stats_back_action(view_t *view)
+{
+	dialog_exit();
+	dialog_redraw();
+}
+
+static void stats_reset_action(view_t *view)
+{
+	panel_reset_stats();
+	lcd_ring_reset_stats();
+	glyph_reset_stats();
+	dialog_reset_stats();
+	dialog_redraw();
+}
+
+/* Every row refreshes all values, the dialog runs a shared hook once */
+#define STATS_ROW(label, row) \
+	CONTROL_STATIC_LIVE(label, values[row], stats_update)
+
+DIALOG_DEFINE(stats_dialog,
+	STATS_ROW("LCD frames:", ROW_FRAMES),
+	STATS_ROW("LCD data/cmd:", ROW_SPLIT),
+	STATS_ROW("udelay:", ROW_UDELAY),
+	STATS_ROW("LCD busy waits:", ROW_BUSY),
+	STATS_ROW("SPI lock wait:", ROW_LOCK_WAIT),
+	STATS_ROW("SPI lock hold max:", ROW_LOCK_HOLD),
+	STATS_ROW("Button polls/idle:", ROW_POLLS),
+	STATS_ROW("Press latency max:", ROW_LATENCY),
+	STATS_ROW("Poll overruns:", ROW_OVERRUNS),
+	STATS_ROW("Debounce toggles:", ROW_TOGGLES),
+	STATS_ROW("Repeats/merged/lost:", ROW_REPEATS),
+	STATS_ROW("LCD ring max/ovf:", ROW_RING),
+	STATS_ROW("Glyph hit/miss/evict:", ROW_GLYPHS),
+	STATS_ROW("Dialog mem/peak/ovf:", ROW_DIALOGS),
+	CONTROL_BUTTON2X("Back", stats_back_action, "Reset", stats_reset_action),
+);
+
+void stats_dialog_show(view_t *view)
+{
+	dialog_enter(&stats_dialog);
+}
@@ -0,0 +1,8 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "dialog.h"
+
+void stats_dialog_show(view_t *view);
+
+#endif /* _STATS_H */
@@ -0,0 +1,37 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "hd44780.h"
+#include "lcd.h"
+#include "panel.h"
+
+/* Runs the rendering bench like a CONFIG_WIFILCD_BENCH boot would, then
+ * shows what is left on the display.  Fails if any frame reached the
+ * controller while it was still busy, or a scenario got lost. */
+int main(void)
+{
+	uint8_t row[PANEL_LCD_COLS + 1] = {0};
+	uint32_t failures;
+
+	panel_init();
+	lcd_init();
+	lcd_data_str((uint8_t *)"Hello world!");
+
+	failures = bench_run();
+
+	for (int i = 0; i < PANEL_LCD_ROWS; i++) {
+		hd44780_read_row(panel_sim_lcd(), i, row);
+		for (int col = 0; col < PANEL_LCD_COLS; col++) {
+			if (row[col] < 8) { /* CGRAM glyph */
+				row[col] = '0' + row[col];
+			}
+		}
+		printf("|%s|\n", row);
+	}
+
+	if (failures) {
+		fprintf(stderr, "%u bench checks failed\n", (unsigned)failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <string.h>
+
+#include <driver/gpio.h>
+#include <esp_event.h>
+#include <esp_wifi.h>
+
+/* The station is configured for "HomeNet" and sees its AP at -60 dBm.  There
+ * is no scan backend on the host, the bench brings its own. */
+
+esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t IP_EVENT = "IP_EVENT";
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+		esp_event_handler_t handler, void *arg)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(esp_interface_t ifx, wifi_config_t *config)
+{
+	memset(config, 0, sizeof(*config));
+	strcpy((char *)config->sta.ssid, "HomeNet");
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(esp_interface_t ifx, wifi_config_t *config)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap)
+{
+	memset(ap, 0, sizeof(*ap));
+	strcpy((char *)ap->ssid, "HomeNet");
+	ap->rssi = -60;
+	return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+	return 1;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t isr, void *arg)
+{
+	return ESP_OK;
+}
@@ -0,0 +1,114 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+
+#include "host.h"
+
+/* Handles only need to be distinct from NULL */
+static int handle;
+
+uint64_t host_time_us = 0;
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name,
+		uint32_t stack_depth, void *param, UBaseType_t priority,
+		TaskHandle_t *handle_out)
+{
+	if (handle_out) {
+		*handle_out = &handle;
+	}
+	return pdPASS;
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+}
+
+BaseType_t xTaskResumeFromISR(TaskHandle_t task)
+{
+	return pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return &handle;
+}
+
+/* Like the scheduler, a delay of n ticks ends on the n-th tick interrupt */
+void vTaskDelay(TickType_t ticks)
+{
+	const uint64_t tick_us = portTICK_PERIOD_MS * 1000;
+
+	host_time_us = (host_time_us / tick_us + ticks) * tick_us;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return host_time_us / (portTICK_PERIOD_MS * 1000);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+	return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	return &handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+	return &handle;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait)
+{
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+	return pdTRUE;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+		UBaseType_t reload, void *id, TimerCallbackFunction_t func)
+{
+	return &handle;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+	return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait)
+{
+	return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+		TickType_t wait)
+{
+	return pdPASS;
+}
@@ -0,0 +1,10 @@
+#ifndef _HOST_H
+#define _HOST_H
+
+#include <stdint.h>
+
+/* Simulated time in microseconds.  LCD frames advance it by their bus time
+ * and task delays by whole ticks, nothing on the host waits for real. */
+extern uint64_t host_time_us;
+
+#endif /* _HOST_H */
@@ -0,0 +1,41 @@
+#ifndef _HOST_GPIO_H
+#define _HOST_GPIO_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define BIT(n) (1UL << (n))
+
+typedef enum {
+	GPIO_NUM_0 = 0,
+} gpio_num_t;
+
+typedef enum {
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef enum {
+	GPIO_INTR_DISABLE,
+	GPIO_INTR_NEGEDGE,
+} gpio_int_type_t;
+
+typedef struct gpio_config_t {
+	uint32_t pin_bit_mask;
+	gpio_mode_t mode;
+	int pull_up_en;
+	int pull_down_en;
+	gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+/* Inputs read high, like the released menu button on GPIO0 */
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level);
+int gpio_get_level(gpio_num_t gpio);
+esp_err_t gpio_install_isr_service(int flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t isr, void *arg);
+
+#endif /* _HOST_GPIO_H */
@@ -0,0 +1,11 @@
+#ifndef _HOST_ESP_ERR_H
+#define _HOST_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#define ESP_ERROR_CHECK(x) ((void)(x))
+
+#endif /* _HOST_ESP_ERR_H */
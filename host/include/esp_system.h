@@ -0,0 +1,6 @@
+#ifndef _HOST_ESP_SYSTEM_H
+#define _HOST_ESP_SYSTEM_H
+
+#include "esp_err.h"
+
+#endif /* _HOST_ESP_SYSTEM_H */
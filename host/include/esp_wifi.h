@@ -0,0 +1,71 @@
+#ifndef _HOST_ESP_WIFI_H
+#define _HOST_ESP_WIFI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "tcpip_adapter.h"
+
+typedef enum {
+	ESP_IF_WIFI_STA = 0,
+} esp_interface_t;
+
+typedef enum {
+	WIFI_AUTH_OPEN = 0,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+} wifi_auth_mode_t;
+
+enum {
+	WIFI_EVENT_SCAN_DONE = 1,
+	WIFI_EVENT_STA_START = 2,
+	WIFI_EVENT_STA_DISCONNECTED = 5,
+};
+
+enum {
+	IP_EVENT_STA_GOT_IP = 0,
+};
+
+enum {
+	WIFI_REASON_ASSOC_LEAVE = 8,
+	WIFI_REASON_NO_AP_FOUND = 201,
+	WIFI_REASON_AUTH_FAIL = 202,
+};
+
+typedef struct wifi_sta_config_t {
+	uint8_t ssid[32];
+	uint8_t password[64];
+} wifi_sta_config_t;
+
+typedef union wifi_config_t {
+	wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct wifi_ap_record_t {
+	uint8_t bssid[6];
+	uint8_t ssid[33];
+	uint8_t primary;
+	int8_t rssi;
+	wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef struct wifi_event_sta_disconnected_t {
+	uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef struct ip_event_got_ip_t {
+	tcpip_adapter_ip_info_t ip_info;
+} ip_event_got_ip_t;
+
+/* The host station is configured for "HomeNet" and never connects */
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_get_config(esp_interface_t ifx, wifi_config_t *config);
+esp_err_t esp_wifi_set_config(esp_interface_t ifx, wifi_config_t *config);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap);
+
+#endif /* _HOST_ESP_WIFI_H */
@@ -0,0 +1,42 @@
+#ifndef _HOST_FREERTOS_H
+#define _HOST_FREERTOS_H
+
+/* Just enough of FreeRTOS for the panel code to run in one host thread.
+ * Ticks are 10 ms like CONFIG_FREERTOS_HZ=100 and advance the simulated
+ * clock in host/freertos.c instead of waiting. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TimerHandle_t;
+typedef void *QueueHandle_t;
+
+typedef TaskHandle_t xTaskHandle;
+typedef SemaphoreHandle_t xSemaphoreHandle;
+typedef TimerHandle_t xTimerHandle;
+typedef QueueHandle_t xQueueHandle;
+
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define tskIDLE_PRIORITY 0
+
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+#define portYIELD_FROM_ISR()
+
+#endif /* _HOST_FREERTOS_H */
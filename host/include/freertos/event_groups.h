@@ -0,0 +1,6 @@
+#ifndef _HOST_EVENT_GROUPS_H
+#define _HOST_EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+
+#endif /* _HOST_EVENT_GROUPS_H */
@@ -0,0 +1,14 @@
+#ifndef _HOST_SEMPHR_H
+#define _HOST_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+/* With a single thread a mutex is always free */
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+
+#endif /* _HOST_SEMPHR_H */
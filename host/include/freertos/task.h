@@ -0,0 +1,23 @@
+#ifndef _HOST_TASK_H
+#define _HOST_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+/* Tasks are never started, the host runs everything from main() */
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name,
+		uint32_t stack_depth, void *param, UBaseType_t priority,
+		TaskHandle_t *handle);
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+BaseType_t xTaskResumeFromISR(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif /* _HOST_TASK_H */
@@ -0,0 +1,17 @@
+#ifndef _HOST_TIMERS_H
+#define _HOST_TIMERS_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+/* Timers are accepted but never fire, callers drive their work directly */
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+		UBaseType_t reload, void *id, TimerCallbackFunction_t func);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+		TickType_t wait);
+
+#endif /* _HOST_TIMERS_H */
@@ -0,0 +1,15 @@
+#ifndef _HOST_IP4_ADDR_H
+#define _HOST_IP4_ADDR_H
+
+#include <stdint.h>
+
+typedef struct ip4_addr {
+	uint32_t addr;
+} ip4_addr_t;
+
+#define ip4_addr1(ip) (((const uint8_t *)(&(ip)->addr))[0])
+#define ip4_addr2(ip) (((const uint8_t *)(&(ip)->addr))[1])
+#define ip4_addr3(ip) (((const uint8_t *)(&(ip)->addr))[2])
+#define ip4_addr4(ip) (((const uint8_t *)(&(ip)->addr))[3])
+
+#endif /* _HOST_IP4_ADDR_H */
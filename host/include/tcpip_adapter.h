@@ -0,0 +1,16 @@
+#ifndef _HOST_TCPIP_ADAPTER_H
+#define _HOST_TCPIP_ADAPTER_H
+
+#include "lwip/ip4_addr.h"
+
+typedef struct tcpip_adapter_ip_info_t {
+	ip4_addr_t ip;
+	ip4_addr_t netmask;
+	ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) ip4_addr1(ipaddr), ip4_addr2(ipaddr), \
+	ip4_addr3(ipaddr), ip4_addr4(ipaddr)
+
+#endif /* _HOST_TCPIP_ADAPTER_H */
@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "hd44780.h"
+#include "host.h"
+#include "panel.h"
+
+/* Stand-in for components/panel/panel.c on the host.  LCD frames go straight
+ * into the HD44780 model and the simulated clock follows the bus, so slow
+ * commands are waited out the way lcd_busy() does it on the device.  The
+ * keypad, LEDs and buzzer are not there.  Events from button_send() and
+ * button_wake() are queued and delivered by button_sync(), there being no
+ * button task. */
+
+static hd44780_t sim_lcd;
+static panel_stats_t stats;
+static uint64_t lcd_busy_until = 0;
+static button_cb_t button_cb = NULL;
+static struct {
+	button_t button;
+	bool down;
+} button_queue[BUTTON_QUEUE_LEN];
+static int button_head = 0;
+static int button_count = 0;
+static bool wake_pending = false;
+static uint16_t leds = 0;
+static uint8_t contrast = 0x1f;
+static uint16_t xfer_buf[LCD_XFER_FRAMES];
+
+void panel_init(void)
+{
+	hd44780_init(&sim_lcd, CONFIG_PANEL_SIM_FRAME_US);
+}
+
+void buzzer_play(uint32_t frequency, uint32_t duration)
+{
+}
+
+void led_set(led_t led, led_state_t state)
+{
+	leds &= ~(0x03 << (led * 2));
+	leds |= state << (led * 2);
+}
+
+led_state_t led_get(led_t led)
+{
+	return (leds >> (led * 2)) & 0x03;
+}
+
+void backlight_set(bool enabled)
+{
+	led_set(LED_BACKLIGHT, enabled ? LED_ON : LED_OFF);
+}
+
+void button_set_cb(button_cb_t cb)
+{
+	button_cb = cb;
+}
+
+button_cb_t button_get_cb(void)
+{
+	return button_cb;
+}
+
+uint8_t button_coalesce(button_t button)
+{
+	return 0;
+}
+
+void button_sync(void)
+{
+	while (button_count) {
+		button_t button = button_queue[button_head].button;
+		bool down = button_queue[button_head].down;
+
+		button_head = (button_head + 1) % BUTTON_QUEUE_LEN;
+		button_count--;
+		if (button == BTN_NONE) {
+			wake_pending = false;
+		}
+		if (button_cb) {
+			button_cb(button, down, host_time_us);
+		}
+	}
+}
+
+void button_send(button_t button, bool down)
+{
+	/* The device would block until the button task made room */
+	if (button_count == BUTTON_QUEUE_LEN) {
+		button_sync();
+	}
+	int tail = (button_head + button_count++) % BUTTON_QUEUE_LEN;
+	button_queue[tail].button = button;
+	button_queue[tail].down = down;
+}
+
+void button_wake(void)
+{
+	if (wake_pending || button_count == BUTTON_QUEUE_LEN) {
+		return;
+	}
+	wake_pending = true;
+	button_send(BTN_NONE, true);
+}
+
+button_repeat_t button_repeat_level(void)
+{
+	return BUTTON_PRESS;
+}
+
+void lcd_busy(uint32_t us)
+{
+	lcd_busy_until = host_time_us + us;
+}
+
+void lcd_write(uint8_t byte, bool command)
+{
+	if (host_time_us < lcd_busy_until) {
+		stats.lcd_busy_waits++;
+		stats.lcd_busy_wait_us += lcd_busy_until - host_time_us;
+		host_time_us = lcd_busy_until;
+	}
+
+	stats.lcd_frames++;
+	if (command) {
+		stats.lcd_commands++;
+	} else {
+		stats.lcd_data++;
+	}
+
+	hd44780_write(&sim_lcd, byte, !command, host_time_us);
+	host_time_us = sim_lcd.bus_free;
+}
+
+void lcd_write_burst(const uint8_t *bytes, size_t len, bool command)
+{
+	for (size_t i = 0; i < len; i++) {
+		lcd_write(bytes[i], command);
+	}
+}
+
+uint16_t *lcd_xfer_buffer(void)
+{
+	return xfer_buf;
+}
+
+void lcd_xfer_submit(size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		lcd_write(xfer_buf[i] & 0xFF, xfer_buf[i] & LCD_XFER_COMMAND);
+	}
+}
+
+bool lcd_xfer_poll(void)
+{
+	return true;
+}
+
+void lcd_xfer_wait(void)
+{
+}
+
+void set_contrast(uint8_t n)
+{
+	contrast = n;
+}
+
+uint8_t get_contrast(void)
+{
+	return contrast;
+}
+
+void panel_get_stats(panel_stats_t *out)
+{
+	*out = stats;
+}
+
+void panel_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+hd44780_t *panel_sim_lcd(void)
+{
+	return &sim_lcd;
+}
+
+uint32_t panel_time_us(void)
+{
+	return host_time_us;
+}
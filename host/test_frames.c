@@ -0,0 +1,96 @@
+#include <stdio.h>
+
+#include "panel_frame.h"
+
+/* Checks the shift register frames against the wire layout the panel PCB
+ * expects, and that the HSPI FIFO packing puts them on the wire MSB first. */
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/* What the FIFO clocks out: data_buf byte 0 first, each byte MSB first */
+static uint32_t hspi_wire(uint32_t word, int bits)
+{
+	uint32_t wire = 0;
+
+	for (int i = 0; i < bits; i += 8) {
+		uint8_t byte = word >> i;
+		for (int bit = 7; bit >= 0; bit--) {
+			wire = wire << 1 | (byte >> bit & 1);
+		}
+	}
+	return wire;
+}
+
+static void test_data_frame(void)
+{
+	/* Full contrast clears the inverted contrast field */
+	CHECK(panel_lcd_frame('A', false, 0x1f) == 0x8141);
+	CHECK(panel_lcd_frame(0x00, false, 0x1f) == 0x8100);
+	CHECK(panel_lcd_frame(0xFF, false, 0x1f) == 0x81FF);
+}
+
+static void test_command_frame(void)
+{
+	CHECK(panel_lcd_frame(0x01, true, 0x1f) == 0x8001);
+	CHECK(panel_lcd_frame(0x80, true, 0x1f) == 0x8080);
+	CHECK(!(panel_lcd_frame(0xFF, true, 0x1f) & PANEL_FRAME_DATA));
+}
+
+static void test_contrast(void)
+{
+	CHECK(panel_contrast_frame(0x1f) == 0x0000);
+	CHECK(panel_contrast_frame(0x00) == 0x7C00);
+	CHECK(panel_contrast_frame(0x10) == 0x3C00);
+	/* Only the low five bits of the contrast are used */
+	CHECK(panel_contrast_frame(0xE0) == 0x7C00);
+	CHECK(!(panel_contrast_frame(0x00) & PANEL_FRAME_STROBE));
+
+	/* LCD frames carry the same contrast so they don't disturb the DAC */
+	for (int c = 0; c < 32; c++) {
+		CHECK((panel_lcd_frame(0x5A, false, c) & 0x7C00) ==
+			panel_contrast_frame(c));
+	}
+}
+
+static void test_hspi_order(void)
+{
+	CHECK(panel_hspi_pack(0x8141, 16) == 0x4181);
+	CHECK(panel_hspi_pack(0xA5, 8) == 0xA5);
+	CHECK(panel_hspi_pack(0x123456, 24) == 0x563412);
+
+	for (int bits = 8; bits <= 32; bits += 8) {
+		uint32_t mask = bits == 32 ? 0xFFFFFFFF : (1u << bits) - 1;
+		uint32_t frame = 0x8E3D41C7 & mask;
+		uint32_t word = panel_hspi_pack(frame, bits);
+
+		CHECK(hspi_wire(word, bits) == frame);
+		CHECK(panel_hspi_unpack(word, bits) == frame);
+	}
+
+	/* Every LCD frame the async transport queues reaches the wire intact */
+	for (int byte = 0; byte < 256; byte++) {
+		uint16_t frame = panel_lcd_frame(byte, byte & 1, 0x0c);
+		CHECK(hspi_wire(panel_hspi_pack(frame, 16), 16) == frame);
+	}
+}
+
+int main(void)
+{
+	test_data_frame();
+	test_command_frame();
+	test_contrast();
+	test_hspi_order();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hd44780.h"
+
+/* Checks the HD44780 model the host bench relies on: what ends up on screen
+ * and, above all, that frames sent while it is busy are counted. */
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/* When the next frame can go out without finding the controller busy */
+static uint64_t idle_at(const hd44780_t *lcd)
+{
+	return lcd->busy_until > lcd->bus_free ? lcd->busy_until : lcd->bus_free;
+}
+
+static void write_str(hd44780_t *lcd, const char *s, uint64_t *now)
+{
+	while (*s) {
+		hd44780_write(lcd, *s++, true, *now);
+		*now = idle_at(lcd);
+	}
+}
+
+static void check_row(hd44780_t *lcd, int row, const char *want)
+{
+	uint8_t buf[41] = {0};
+
+	hd44780_read_row(lcd, row, buf);
+	CHECK(!memcmp(buf, want, strlen(want)));
+}
+
+/* At 360 us per frame the bus is always slower than the controller */
+static void test_slow_bus(void)
+{
+	hd44780_t lcd;
+	uint64_t now = 0;
+
+	hd44780_init(&lcd, 360);
+	hd44780_write(&lcd, 0x0C, false, now);
+	hd44780_write(&lcd, 0xC2, false, now);
+	now = lcd.bus_free;
+	write_str(&lcd, "Hi", &now);
+
+	check_row(&lcd, 0, "    ");
+	check_row(&lcd, 1, "  Hi");
+	CHECK(lcd.address == 0x44);
+	CHECK(lcd.stats.frames == 4);
+	CHECK(lcd.stats.commands == 2);
+	CHECK(lcd.stats.data == 2);
+	CHECK(lcd.stats.bus_us == 4 * 360);
+	CHECK(lcd.stats.busy_violations == 0);
+}
+
+/* A frame latched inside a clear's execution time is a violation, one sent
+ * after it is not */
+static void test_clear_busy(void)
+{
+	hd44780_t lcd;
+	uint64_t now = 0;
+
+	hd44780_init(&lcd, 10);
+	hd44780_write(&lcd, 0x0C, false, now);
+	now = idle_at(&lcd);
+	write_str(&lcd, "abc", &now);
+	hd44780_write(&lcd, 0x01, false, now);
+	uint64_t cleared = lcd.bus_free;
+
+	hd44780_write(&lcd, 'x', true, cleared);
+	CHECK(lcd.stats.busy_violations == 1);
+	CHECK(lcd.stats.clears == 1);
+
+	now = cleared + HD44780_EXEC_SLOW_US;
+	hd44780_write(&lcd, 0x01, false, now);
+	hd44780_write(&lcd, 'y', true, lcd.bus_free + HD44780_EXEC_SLOW_US);
+	CHECK(lcd.stats.busy_violations == 1);
+	check_row(&lcd, 0, "y   ");
+}
+
+/* Back to back frames at a bus faster than the controller */
+static void test_fast_bus(void)
+{
+	hd44780_t lcd;
+
+	hd44780_init(&lcd, 10);
+	hd44780_write(&lcd, 0x0C, false, 0);
+	uint64_t start = idle_at(&lcd);
+	for (int i = 0; i < 4; i++) {
+		hd44780_write(&lcd, 'a' + i, true, start);
+	}
+	CHECK(lcd.stats.busy_violations == 3);
+	CHECK(lcd.bus_free == start + 40);
+	check_row(&lcd, 0, "abcd");
+}
+
+static void test_shift_and_home(void)
+{
+	hd44780_t lcd;
+	uint64_t now = 0;
+
+	hd44780_init(&lcd, 360);
+	hd44780_write(&lcd, 0x0C, false, now);
+	now = lcd.bus_free;
+	write_str(&lcd, "0123", &now);
+	hd44780_write(&lcd, 0x18, false, now); /* Shift display left */
+	now = lcd.bus_free;
+	check_row(&lcd, 0, "123 ");
+	CHECK(lcd.shift == 1);
+
+	hd44780_write(&lcd, 0x02, false, now);
+	now = lcd.bus_free + HD44780_EXEC_SLOW_US;
+	CHECK(lcd.shift == 0);
+	CHECK(lcd.address == 0);
+	CHECK(lcd.stats.homes == 1);
+	check_row(&lcd, 0, "0123");
+
+	hd44780_write(&lcd, 0x40, false, now); /* CGRAM 0 */
+	now = lcd.bus_free;
+	write_str(&lcd, "\x1f\x11", &now);
+	CHECK(lcd.cgram[0] == 0x1f && lcd.cgram[1] == 0x11);
+	CHECK(lcd.stats.busy_violations == 0);
+}
+
+int main(void)
+{
+	test_slow_bus();
+	test_clear_busy();
+	test_fast_bus();
+	test_shift_and_home();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tz.h"
+
+/* Cross-checks tz_localtime() against glibc's localtime_r() for the same
+ * POSIX TZ strings, every ~30 minutes from 1998 to 2036.  The step is odd so
+ * that the samples drift through every minute and second of the day. */
+
+#define FROM 883612800  /* 1998-01-01 */
+#define UNTIL 2082758400 /* 2036-01-01 */
+#define STEP 1799
+
+static const char *const zones[] = {
+	"UTC0",
+	"CST6CDT,M3.2.0,M11.1.0",
+	"CET-1CEST,M3.5.0,M10.5.0/3",
+	"GMT0BST,M3.5.0/1,M10.5.0",
+	"AEST-10AEDT,M10.1.0,M4.1.0/3",
+	"NZST-12NZDT,M9.5.0,M4.1.0/3",
+	"IST-5:30",
+	"<+0330>-3:30",
+	"<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+	"EST5EDT,J60/2,J300/2",
+	"XST3XDT,100,250/1:30",
+};
+
+static const char *const malformed[] = {
+	"",
+	"CST",
+	"CST6CDT,M3.2.0",
+	"CST6CDT,M13.2.0,M11.1.0",
+	"<CST6",
+};
+
+static int check_zone(const char *spec)
+{
+	struct tm want, got;
+	int mismatches = 0;
+
+	if (!tz_set(spec)) {
+		fprintf(stderr, "%s: not accepted\n", spec);
+		return 1;
+	}
+	setenv("TZ", spec, 1);
+	tzset();
+
+	for (time_t t = FROM; t < UNTIL; t += STEP) {
+		localtime_r(&t, &want);
+		tz_localtime(t, &got);
+
+		if (got.tm_year != want.tm_year || got.tm_mon != want.tm_mon ||
+				got.tm_mday != want.tm_mday ||
+				got.tm_hour != want.tm_hour ||
+				got.tm_min != want.tm_min || got.tm_sec != want.tm_sec ||
+				got.tm_wday != want.tm_wday ||
+				got.tm_yday != want.tm_yday ||
+				got.tm_isdst != want.tm_isdst) {
+			if (mismatches++ < 5) {
+				fprintf(stderr, "%s at %lld: got %04d-%02d-%02d %02d:%02d:%02d "
+						"dst %d, want %04d-%02d-%02d %02d:%02d:%02d dst %d\n",
+						spec, (long long)t, got.tm_year + 1900,
+						got.tm_mon + 1, got.tm_mday, got.tm_hour, got.tm_min,
+						got.tm_sec, got.tm_isdst, want.tm_year + 1900,
+						want.tm_mon + 1, want.tm_mday, want.tm_hour,
+						want.tm_min, want.tm_sec, want.tm_isdst);
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	for (int i = 0; i < sizeof(zones) / sizeof(zones[0]); i++) {
+		failures += check_zone(zones[i]) != 0;
+	}
+
+	for (int i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+		if (tz_set(malformed[i])) {
+			fprintf(stderr, "%s: accepted\n", malformed[i]);
+			failures++;
+		}
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d zones failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,302 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "bench.h"
+#include "clock.h"
+#include "dialog.h"
+#include "lcd.h"
+#include "menu.h"
+#include "panel.h"
+#include "scan.h"
+#include "tz.h"
+
+
+#define arraysize(a) \
+	(sizeof(a) / sizeof(a[0]))
+
+/* Scenarios navigate by key presses alone, so each names the control it
+ * should end on and the bench stops when it ends anywhere else.  NULL skips
+ * the check, for scenarios that run without a dialog. */
+typedef struct scenario_t {
+	const char *name;
+	void (*run)(void);
+	const char *selected;
+} scenario_t;
+
+/* Presses and wakes go through the button queue like the real ones, so the
+ * callback only ever runs in the button task, interleaved with the refresh
+ * and marquee timer wakes instead of racing them */
+static void press(button_t button)
+{
+	button_send(button, true);
+	button_send(button, false);
+	button_sync();
+}
+
+static void wake(void)
+{
+	button_wake();
+	button_sync();
+}
+
+/* Synthetic scan results, 24 networks per channel with 280 distinct names,
+ * so names repeat across channels at different strengths */
+#define SYNTH_PER_CHANNEL 24
+
+static uint8_t synth_channel;
+static uint16_t synth_pos;
+
+static bool synth_start(uint8_t channel)
+{
+	synth_channel = channel;
+	synth_pos = 0;
+	return true;
+}
+
+static uint16_t synth_read(scan_ap_t *aps, uint16_t max)
+{
+	uint16_t n = 0;
+
+	while (n < max && synth_pos < SYNTH_PER_CHANNEL) {
+		uint32_t k = synth_channel * SYNTH_PER_CHANNEL + synth_pos++;
+		snprintf(aps[n].ssid, sizeof(aps[n].ssid), "net-%03" PRIu32, k % 280);
+		aps[n].rssi = -30 - (int)(k * 37 % 65);
+		aps[n].channel = synth_channel;
+		aps[n].authmode = 0;
+		n++;
+	}
+
+	return n;
+}
+
+static const scan_backend_t synth_backend = {
+	.start = synth_start,
+	.read = synth_read,
+};
+
+static void menu_open_scenario(void)
+{
+	menu_open();
+}
+
+static void wifi_status_enter_scenario(void)
+{
+	press(BTN_ENTER);
+}
+
+static void wifi_status_scroll_scenario(void)
+{
+	for (int i = 0; i < 3; i++) {
+		press(BTN_DOWN);
+	}
+}
+
+/* Refresh ticks with the RSSI row shown and steady */
+static void wifi_status_refresh_scenario(void)
+{
+	for (int i = 0; i < 10; i++) {
+		wake();
+	}
+}
+
+static void wifi_status_back_scenario(void)
+{
+	press(BTN_ENTER);
+}
+
+static void stats_enter_scenario(void)
+{
+	press(BTN_DOWN);
+	press(BTN_ENTER);
+	for (int i = 0; i < 12; i++) {
+		press(BTN_DOWN);
+	}
+}
+
+/* The selected "Glyph hit/miss/evict:" label is too long for its field */
+static void stats_marquee_scenario(void)
+{
+	for (int i = 0; i < 20; i++) {
+		vTaskDelay(CONFIG_PANEL_MARQUEE_MS / portTICK_PERIOD_MS);
+		wake();
+	}
+}
+
+static void stats_back_scenario(void)
+{
+	press(BTN_DOWN);
+	press(BTN_DOWN);
+	press(BTN_ENTER);
+	press(BTN_UP);
+}
+
+static void wifi_config_enter_scenario(void)
+{
+	press(BTN_RIGHT);
+	press(BTN_ENTER);
+}
+
+static void ssid_edit_scenario(void)
+{
+	press(BTN_ENTER);
+	for (int i = 0; i < 32; i++) {
+		press(BTN_UP);
+		press(BTN_RIGHT);
+	}
+	press(BTN_ENTER);
+}
+
+/* In-place changes that don't scroll the field */
+static void ssid_retype_scenario(void)
+{
+	press(BTN_ENTER);
+	for (int i = 0; i < 4; i++) {
+		press(BTN_LEFT);
+	}
+	for (int i = 0; i < 8; i++) {
+		press(BTN_UP);
+	}
+	press(BTN_LEFT);
+	for (int i = 0; i < 8; i++) {
+		press(BTN_DOWN);
+	}
+	press(BTN_ENTER);
+}
+
+static void wifi_scan_scenario(void)
+{
+	const scan_backend_t *saved = scan_set_backend(&synth_backend);
+
+	for (int i = 0; i < 3; i++) {
+		press(BTN_DOWN);
+	}
+	press(BTN_ENTER); /* Scan */
+	while (scan_running()) {
+		scan_done();
+		wake();
+	}
+
+	/* The results stay for wifi_scan_browse */
+	scan_set_backend(saved);
+}
+
+static void wifi_scan_browse_scenario(void)
+{
+	press(BTN_UP);
+	press(BTN_ENTER);
+	for (int i = 0; i < 20; i++) {
+		press(BTN_DOWN);
+	}
+	press(BTN_ENTER);
+}
+
+static void menu_close_scenario(void)
+{
+	menu_close();
+}
+
+/* Switching to the clock is only done once the first frame is up.  Times go
+ * through the configured zone, as clock_task() shows them. */
+static void clock_setup_scenario(void)
+{
+	time_t ts = 1700000000;
+	struct tm tm;
+
+	clock_set_timezone(CONFIG_WIFILCD_CLOCK_TZ);
+	tz_localtime(ts, &tm);
+	clock_setup();
+	clock_draw(&tm, true);
+}
+
+static void clock_hour_scenario(void)
+{
+	time_t ts = 1700000000;
+	struct tm tm;
+
+	for (int i = 0; i < 3600; i++, ts++) {
+		tz_localtime(ts, &tm);
+		clock_draw(&tm, true);
+		clock_draw(&tm, false);
+	}
+}
+
+static void lcd_init_scenario(void)
+{
+	lcd_init();
+}
+
+static const scenario_t scenarios[] = {
+	{"menu_open", menu_open_scenario, "WiFi Status"},
+	{"wifi_status_enter", wifi_status_enter_scenario, "WiFi Status:"},
+	{"wifi_status_scroll", wifi_status_scroll_scenario, "Back"},
+	{"wifi_status_refresh", wifi_status_refresh_scenario, "Back"},
+	{"wifi_status_back", wifi_status_back_scenario, "WiFi Status"},
+	{"stats_enter", stats_enter_scenario, "Glyph hit/miss/evict:"},
+	{"stats_marquee", stats_marquee_scenario, "Glyph hit/miss/evict:"},
+	{"stats_back", stats_back_scenario, "WiFi Status"},
+	{"wifi_config_enter", wifi_config_enter_scenario, "WiFi SSID:"},
+	{"ssid_edit", ssid_edit_scenario, "WiFi SSID:"},
+	{"ssid_retype", ssid_retype_scenario, "WiFi SSID:"},
+	{"wifi_scan", wifi_scan_scenario, "Scan"},
+	{"wifi_scan_browse", wifi_scan_browse_scenario, "Networks:"},
+	{"menu_close", menu_close_scenario, NULL},
+	{"clock_setup", clock_setup_scenario, NULL},
+	{"clock_hour", clock_hour_scenario, NULL},
+	{"lcd_init", lcd_init_scenario, NULL},
+};
+
+/* Runs every scenario against the simulated panel and prints one JSON object
+ * per line, so that results can be collected from the console and diffed.
+ * wall_us is how long the scenario took until the display was idle again.
+ * Returns the number of failed checks: frames that reached the controller
+ * while busy, plus one if a scenario ended on the wrong control, which also
+ * ends the run as the scenarios after it would measure the wrong screens. */
+uint32_t bench_run(void)
+{
+	hd44780_t *lcd = panel_sim_lcd();
+	uint32_t start_us, wall_us;
+	uint32_t failures = 0;
+	const char *selected;
+
+	if (!lcd) {
+		printf("{\"error\": \"bench needs the simulated panel transport\"}\n");
+		return 0;
+	}
+
+	for (int i = 0; i < arraysize(scenarios); i++) {
+		lcd_wait_idle();
+		hd44780_reset_stats(lcd);
+		start_us = panel_time_us();
+
+		scenarios[i].run();
+
+		lcd_wait_idle();
+		wall_us = panel_time_us() - start_us;
+		failures += lcd->stats.busy_violations;
+		printf("{\"scenario\": \"%s\", \"data\": %" PRIu32 ", "
+				"\"commands\": %" PRIu32 ", \"clears\": %" PRIu32 ", "
+				"\"homes\": %" PRIu32 ", \"busy_violations\": %" PRIu32 ", "
+				"\"bus_us\": %llu, \"exec_us\": %llu, \"wall_us\": %" PRIu32 "}\n",
+				scenarios[i].name, lcd->stats.data, lcd->stats.commands,
+				lcd->stats.clears, lcd->stats.homes,
+				lcd->stats.busy_violations,
+				(unsigned long long)lcd->stats.bus_us,
+				(unsigned long long)lcd->stats.exec_us, wall_us);
+
+		selected = dialog_selected_label();
+		if (scenarios[i].selected && (!selected ||
+				strcmp(selected, scenarios[i].selected))) {
+			printf("{\"scenario\": \"%s\", \"error\": \"ended on '%s', "
+					"expected '%s'\"}\n", scenarios[i].name,
+					selected ? selected : "no dialog", scenarios[i].selected);
+			return failures + 1;
+		}
+	}
+
+	return failures;
+}
@@ -0,0 +1,8 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+
+uint32_t bench_run(void);
+
+#endif /* _BENCH_H */
@@ -1,90 +1,128 @@
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 
 #include "clock.h"
+#include "glyph.h"
 #include "lcd.h"
+#include "tz.h"
 
 
 void clock_task(void *pvParameters);
 
-static const uint8_t cgram[] = {
-	0b00000011, /* 0 */
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000011,
-
-	0b00011000, /* 1 */
-	0b00011100,
-	0b00011100,
-	0b00011100,
-	0b00011100,
-	0b00011100,
-	0b00011100,
-	0b00011000,
-
-	0b00011111, /* 2 */
-	0b00011111,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-
-	0b00000000, /* 3 */
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00011111,
-	0b00011111,
-
-	0b00011111, /* 4 */
-	0b00011111,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00011111,
-	0b00011111,
-
-	0b00000001, /* 5 */
-	0b00000011,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-
-	0b00000000, /* 6 */
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000001,
-	0b00000011,
-
-	0b00000000, /* 7 */
-	0b00000000,
-	0b00000000,
-	0b00001110,
-	0b00001110,
-	0b00000000,
-	0b00000000,
-	0b00000000,
+#define SEGMENT_COUNT 8
+
+static const glyph_t segments[SEGMENT_COUNT] = {
+	{{ /* 0 */
+		0b00000011,
+		0b00000111,
+		0b00000111,
+		0b00000111,
+		0b00000111,
+		0b00000111,
+		0b00000111,
+		0b00000011,
+	}},
+	{{ /* 1 */
+		0b00011000,
+		0b00011100,
+		0b00011100,
+		0b00011100,
+		0b00011100,
+		0b00011100,
+		0b00011100,
+		0b00011000,
+	}},
+	{{ /* 2 */
+		0b00011111,
+		0b00011111,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+	}},
+	{{ /* 3 */
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00011111,
+		0b00011111,
+	}},
+	{{ /* 4 */
+		0b00011111,
+		0b00011111,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00011111,
+		0b00011111,
+	}},
+	{{ /* 5 */
+		0b00000001,
+		0b00000011,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+	}},
+	{{ /* 6 */
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00000001,
+		0b00000011,
+	}},
+	{{ /* 7 */
+		0b00000000,
+		0b00000000,
+		0b00000000,
+		0b00001110,
+		0b00001110,
+		0b00000000,
+		0b00000000,
+		0b00000000,
+	}},
 };
 
+/* CGRAM character codes for segments[], valid during clock_draw() */
+static uint8_t segment_char[SEGMENT_COUNT];
+
+/* What is on screen, so that clock_draw() only touches cells that change */
+static struct {
+	bool valid;
+	bool clear; /* cells outside the clock still hold the previous screen */
+	uint8_t digits[4];
+	bool pm;
+	bool colon;
+	int yday;
+	int year;
+	uint8_t segment_char[SEGMENT_COUNT];
+} shown;
+
+static clock_stats_t clock_stats;
+
+/* Held by the clock from its first glyph_get() to its last glyph_put(), the
+ * menu takes it to hand the display over between frames rather than
+ * suspending the clock with the framebuffer open or glyphs pinned */
+static xSemaphoreHandle draw_lock = NULL;
+
 struct digitmap_t {
 	uint8_t top[3];
 	uint8_t bottom[3];
@@ -162,31 +200,62 @@ const char *mon[] = {
 	"December"
 };
 
+/* Takes a POSIX TZ string, e.g. "CST6CDT,M3.2.0,M11.1.0" */
+bool clock_set_timezone(const char *tz)
+{
+	return tz_set(tz);
+}
+
 xTaskHandle clock_start(void)
 {
 	xTaskHandle task;
 
-	setenv("TZ", "CST6CDT", 1);
+	clock_set_timezone(CONFIG_WIFILCD_CLOCK_TZ);
 
+	draw_lock = xSemaphoreCreateMutex();
 	xTaskCreate(clock_task, "clock", 1536, NULL, tskIDLE_PRIORITY, &task);
 
 	return task;
 }
 
+/* Waits for the frame being drawn to end and keeps the clock off the display
+ * until clock_resume() */
+void clock_pause(void)
+{
+	if (draw_lock) {
+		xSemaphoreTake(draw_lock, portMAX_DELAY);
+	}
+}
+
+void clock_resume(void)
+{
+	if (draw_lock) {
+		xSemaphoreGive(draw_lock);
+	}
+}
+
+static inline uint8_t segment_cell(uint8_t c)
+{
+	return c < SEGMENT_COUNT ? segment_char[c] : c;
+}
+
 static void draw_big_digit(uint8_t n, uint8_t pos)
 {
 	if (n > 10 || pos > 36) {
 		return;
 	}
 
-	lcd_command(0x80 + pos);
+	uint8_t top[3], bottom[3];
+
 	for (int i = 0; i < 3; i++) {
-		lcd_data(digitmap[n].top[i]);
+		top[i] = segment_cell(digitmap[n].top[i]);
+		bottom[i] = segment_cell(digitmap[n].bottom[i]);
 	}
+
+	lcd_command(0x80 + pos);
+	lcd_data_buf(top, 3);
 	lcd_command(0xC0 + pos);
-	for (int i = 0; i < 3; i++) {
-		lcd_data(digitmap[n].bottom[i]);
-	}
+	lcd_data_buf(bottom, 3);
 }
 
 static void draw_big_colon(uint8_t pos, bool visible)
@@ -196,91 +265,198 @@ static void draw_big_colon(uint8_t pos, bool visible)
 	}
 
 	lcd_command(0x80 + pos);
-	lcd_data(visible ? '\x07' : ' ');
+	lcd_data(visible ? segment_char[7] : ' ');
 	lcd_command(0xC0 + pos);
-	lcd_data(visible ? '\x07' : ' ');
+	lcd_data(visible ? segment_char[7] : ' ');
 }
 
 static void draw_big_time(struct tm *tm, uint8_t pos, bool colon_visible)
 {
+	static const uint8_t digit_pos[4] = {0, 3, 7, 10};
 	const bool millitary_time = false;
+	uint8_t digits[4];
+	bool pm = tm->tm_hour >= 12;
+
+	if (millitary_time) {
+		digits[0] = tm->tm_hour / 10;
+		digits[1] = tm->tm_hour % 10;
+	} else {
+		uint8_t hour = tm->tm_hour % 12;
+		if (hour == 0) {
+			hour = 12;
+		}
+		digits[0] = hour / 10 == 0 ? 10 : hour / 10;
+		digits[1] = hour % 10;
+	}
+	digits[2] = tm->tm_min / 10;
+	digits[3] = tm->tm_min % 10;
 
-	if (colon_visible) {
-		if (millitary_time) {
-			draw_big_digit(tm->tm_hour / 10, pos);
-			draw_big_digit(tm->tm_hour % 10, pos + 3);
-		} else {
-			uint8_t hour = tm->tm_hour % 12;
-			if (hour == 0) {
-				draw_big_digit(1, pos);
-				draw_big_digit(2, pos + 3);
-			} else {
-				draw_big_digit(hour / 10 == 0 ? 10 : hour / 10, pos);
-				draw_big_digit(hour % 10, pos + 3);
-			}
-
-			lcd_command(0xC0 + pos + 13);
-			if (tm->tm_hour < 12) {
-				lcd_data_str((const uint8_t*)"am");
-			} else {
-				lcd_data_str((const uint8_t*)"pm");
-			}
+	for (int i = 0; i < 4; i++) {
+		if (!shown.valid || shown.digits[i] != digits[i]) {
+			draw_big_digit(digits[i], pos + digit_pos[i]);
+			shown.digits[i] = digits[i];
 		}
+	}
 
-		draw_big_digit(tm->tm_min / 10, pos + 7);
-		draw_big_digit(tm->tm_min % 10, pos + 10);
+	if (!millitary_time && (!shown.valid || shown.pm != pm)) {
+		lcd_command(0xC0 + pos + 13);
+		lcd_data_str((const uint8_t*)(pm ? "pm" : "am"));
+		shown.pm = pm;
 	}
 
-	draw_big_colon(pos + 6, colon_visible);
+	if (!shown.valid || shown.colon != colon_visible) {
+		draw_big_colon(pos + 6, colon_visible);
+		shown.colon = colon_visible;
+	}
 }
 
 static void draw_date(struct tm *tm, uint8_t pos)
 {
-	char mday[3];
+	char line[24];
 
-	lcd_command(0x80 + pos);
-	lcd_data_str((const uint8_t*)wday[tm->tm_wday]);
-	lcd_data(',');
-	lcd_data(' ');
-	lcd_data_str((const uint8_t*)mon[tm->tm_mon]);
-	lcd_data(' ');
-
-	sprintf(mday, "%d", tm->tm_mday);
-	lcd_data_str((const uint8_t*)mday);
-
-	int n = strlen(wday[tm->tm_wday]) + 2 + strlen(mon[tm->tm_mon]) + 1 + strlen(mday);
-	while (n++ < 23) {
-		lcd_data(' ');
+	if (shown.valid && shown.yday == tm->tm_yday &&
+			shown.year == tm->tm_year) {
+		return;
 	}
+	shown.yday = tm->tm_yday;
+	shown.year = tm->tm_year;
+
+	int n = snprintf(line, sizeof(line), "%s, %s %d", wday[tm->tm_wday],
+			mon[tm->tm_mon], tm->tm_mday);
+	while (n < 23) {
+		line[n++] = ' ';
+	}
+
+	lcd_command(0x80 + pos);
+	lcd_data_buf((const uint8_t*)line, 23);
 }
 
-void clock_task(void *pvParameters)
+void clock_setup(void)
 {
-	time_t ts;
-	static struct tm *tm;
+	shown.valid = false;
+	shown.clear = true;
+}
 
-	lcd_command(0x01); /* Clear display */
-	lcd_command(0x02); /* Return home */
-	lcd_command(0x40); /* CGRAM addr 0 */
+void clock_draw(struct tm *tm, bool colon_visible)
+{
+	if (draw_lock) {
+		xSemaphoreTake(draw_lock, portMAX_DELAY);
+	}
 
-	for (int i = 0; i < sizeof(cgram); i++) {
-		lcd_data(cgram[i]);
+	for (int i = 0; i < SEGMENT_COUNT; i++) {
+		segment_char[i] = glyph_get(&segments[i]);
+		/* Cells drawn with an old slot are stale if a glyph moved */
+		if (segment_char[i] != shown.segment_char[i]) {
+			shown.segment_char[i] = segment_char[i];
+			shown.valid = false;
+		}
 	}
 
-	portTickType xLastWakeTime = xTaskGetTickCount();
+	lcd_fb_begin();
+	if (shown.clear) {
+		/* Cleared in the framebuffer, the flush only blanks what the
+		 * clock does not cover and nothing waits on a real clear */
+		lcd_command(0x01);
+		shown.clear = false;
+	}
+	draw_big_time(tm, 0, colon_visible);
+	draw_date(tm, 16);
+	lcd_fb_end();
+	shown.valid = true;
+
+	for (int i = 0; i < SEGMENT_COUNT; i++) {
+		glyph_put(&segments[i]);
+	}
+
+	if (draw_lock) {
+		xSemaphoreGive(draw_lock);
+	}
+}
+
+static int64_t clock_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void clock_get_stats(clock_stats_t *stats)
+{
+	*stats = clock_stats;
+}
+
+/* The next update seeds the skew range again */
+void clock_reset_stats(void)
+{
+	clock_stats.updates = 0;
+}
+
+/* The system clock boots at the epoch, anything earlier than 2020 means
+ * SNTP has not set it yet */
+#define CLOCK_VALID_AFTER 1577836800
+
+/* Redraws on every half second edge of the system clock, the colon is shown
+ * for the first half.  The wake up is moved ahead by how long a draw took to
+ * reach the display last time, so that the new second lands on the edge.
+ * Skew is only sampled once SNTP set the clock, and without the part of a
+ * tick the wake up was rounded up by, which no lead can take back. */
+void clock_task(void *pvParameters)
+{
+	struct tm tm;
+	int64_t now_us, edge_us, draw_us;
+	int64_t last_edge_us = 0;
+	int32_t lead_us = 0;
+	int32_t rounding_us;
+	const int32_t tick_us = portTICK_PERIOD_MS * 1000;
+
+	clock_setup();
 
 	while (true) {
-		time(&ts);
-		setenv("TZ", "CST6CDT", 1);
-		tm = localtime(&ts);
+		now_us = clock_now_us();
+		edge_us = (now_us + lead_us) / 500000 * 500000 + 500000;
+		if (edge_us <= last_edge_us) {
+			edge_us = last_edge_us + 500000;
+		}
+		last_edge_us = edge_us;
+
+		/* Work out what to show before going to sleep */
+		bool colon_visible = edge_us % 1000000 == 0;
+		tz_localtime(edge_us / 1000000, &tm);
+
+		int64_t wait_us = edge_us - lead_us - now_us;
+		rounding_us = 0;
+		if (wait_us > 0) {
+			int32_t ticks = (wait_us + tick_us - 1) / tick_us;
+			rounding_us = ticks * tick_us - wait_us;
+			vTaskDelay(ticks);
+		}
+
+		draw_us = clock_now_us();
+		clock_draw(&tm, colon_visible);
+		lcd_wait_idle();
+		now_us = clock_now_us();
 
-		draw_big_time(tm, 0, true);
-		draw_date(tm, 16);
+		int32_t skew_us = now_us - edge_us;
+		if (skew_us < -500000 || skew_us > 500000) {
+			/* Paused by the menu or the clock was stepped by SNTP */
+			continue;
+		}
 
-		vTaskDelayUntil(&xLastWakeTime, 500 / portTICK_PERIOD_MS);
-		draw_big_time(tm, 0, false);
+		lead_us += (int32_t)(now_us - draw_us - lead_us) / 8;
 
-		vTaskDelayUntil(&xLastWakeTime, 500 / portTICK_PERIOD_MS);
+		if (edge_us / 1000000 < CLOCK_VALID_AFTER) {
+			continue;
+		}
 
+		skew_us -= rounding_us;
+		clock_stats.skew_us = skew_us;
+		if (!clock_stats.updates || skew_us > clock_stats.skew_max_us) {
+			clock_stats.skew_max_us = skew_us;
+		}
+		if (!clock_stats.updates || skew_us < clock_stats.skew_min_us) {
+			clock_stats.skew_min_us = skew_us;
+		}
+		clock_stats.updates++;
 	}
 }
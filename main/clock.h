@@ -1,8 +1,30 @@
 #ifndef _CLOCK_H
 #define _CLOCK_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
 #include "freertos/task.h"
 
+/* Skew is when an update reached the display minus the second edge it
+ * shows, in microseconds, less the rounding of the wake up to whole ticks.
+ * Updates before SNTP set the clock are not counted, and the range is only
+ * valid once updates is non-zero. */
+typedef struct clock_stats_t {
+	uint32_t updates;
+	int32_t skew_us;
+	int32_t skew_min_us;
+	int32_t skew_max_us;
+} clock_stats_t;
+
 xTaskHandle clock_start(void);
+bool clock_set_timezone(const char *tz);
+void clock_setup(void);
+void clock_draw(struct tm *tm, bool colon_visible);
+void clock_pause(void);
+void clock_resume(void);
+void clock_get_stats(clock_stats_t *stats);
+void clock_reset_stats(void);
 
 #endif /* _CLOCK_H */
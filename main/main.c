@@ -11,14 +11,14 @@
 #include <nvs_flash.h>
 #include <esp_sntp.h>
 
+#include "bench.h"
 #include "clock.h"
 #include "lcd.h"
 #include "menu.h"
 #include "panel.h"
+#include "scan.h"
 
 
-static xTaskHandle main_task_handle = NULL;
-
 static void wifi_init()
 {
     tcpip_adapter_init();
@@ -34,7 +34,8 @@ void app_main(void)
     panel_init();
     lcd_init();
     wifi_init();
-    menu_init(&main_task_handle);
+    scan_set_backend(&scan_esp_backend);
+    menu_init();
 
     sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_setservername(0, "pool.ntp.org");
@@ -43,5 +44,9 @@ void app_main(void)
     lcd_data_str((uint8_t*)"Hello world!");
     buzzer_play(440, 100);
 
-    main_task_handle = clock_start();
+#if defined(CONFIG_WIFILCD_BENCH)
+    bench_run();
+#else
+    clock_start();
+#endif
 }
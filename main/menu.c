@@ -1,3 +1,5 @@
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <freertos/FreeRTOS.h>
@@ -11,9 +13,12 @@
 #include <esp_wifi.h>
 #include <tcpip_adapter.h>
 
+#include "clock.h"
 #include "dialog.h"
 #include "lcd.h"
 #include "panel.h"
+#include "scan.h"
+#include "stats.h"
 
 #include "menu.h"
 
@@ -27,29 +32,37 @@ typedef struct wifi_status_t {
 	char rssi[9];
 } wifi_status_t;
 
+typedef struct clock_status_t {
+	char updates[11];
+	char skew[21];
+	char range[21];
+} clock_status_t;
+
 static lcd_state_t lcd_state;
 
 static wifi_status_t s_wifi_status;
+static clock_status_t s_clock_status;
 static wifi_config_t s_wifi_config;
 static int s_retry_num = 0;
+static uint32_t s_scan_index;
+static scan_ap_t s_scan_item;
+static volatile bool s_scan_changed = false;
 
 static void show_main_dialog(void);
 static void show_wifi_status_dialog(view_t *view);
 static void show_wifi_config_dialog(view_t *view);
+static void show_clock_stats_dialog(view_t *view);
+
+DIALOG_DEFINE(main_dialog,
+	CONTROL_BUTTON2X("WiFi Status", show_wifi_status_dialog,
+			"WiFi Config", show_wifi_config_dialog),
+	CONTROL_BUTTON2X("Panel Stats", stats_dialog_show,
+			"Clock Stats", show_clock_stats_dialog),
+);
 
 static void show_main_dialog(void)
 {
-	dialog_t *dialog = dialog_new();
-
-	control_button2x_t button2x = {
-		.type = CONTROL_TYPE_BUTTON2X,
-		.label = "WiFi Status",
-		.label2 = "WiFi Config",
-		.action = show_wifi_status_dialog,
-		.action2 = show_wifi_config_dialog,
-	};
-	dialog_append(&dialog, &button2x);
-	dialog_enter(dialog);
+	dialog_enter(&main_dialog);
 }
 
 static void event_handler(void* arg, esp_event_base_t event_base,
@@ -75,6 +88,8 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 				strcpy(s_wifi_status.status, "Connect fail");
 			}
 		}
+	} else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+		scan_done();
 	} else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
 		ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
 		sprintf(s_wifi_status.ip, IPSTR, IP2STR(&event->ip_info.ip));
@@ -83,55 +98,144 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 	}
 }
 
-static void wifi_status_update(void)
+static void wifi_status_update(view_t *view)
 {
 	wifi_ap_record_t ap;
-	esp_wifi_sta_get_ap_info(&ap);
-	sprintf(s_wifi_status.rssi, "%d dBm", ap.rssi);
+
+	if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+		sprintf(s_wifi_status.rssi, "%d dBm", ap.rssi);
+	} else {
+		strcpy(s_wifi_status.rssi, "-");
+	}
 }
 
 static void wifi_status_back_action(view_t *view)
 {
-	dialog_t *dialog = view->dialog;
 	dialog_exit();
-	dialog->free(dialog);
 	dialog_redraw();
 }
 
+DIALOG_DEFINE(wifi_status_dialog,
+	CONTROL_STATIC("WiFi Status:", s_wifi_status.status),
+	CONTROL_STATIC("WiFi IP:", s_wifi_status.ip),
+	CONTROL_STATIC_LIVE("WiFi RSSI:", s_wifi_status.rssi, wifi_status_update),
+	CONTROL_BUTTON("Back", wifi_status_back_action),
+);
+
 static void show_wifi_status_dialog(view_t *view)
 {
-	dialog_t *dialog = dialog_new();
+	dialog_enter(&wifi_status_dialog);
+}
 
-	wifi_status_update();
+static void clock_status_update(view_t *view)
+{
+	clock_stats_t stats;
+
+	clock_get_stats(&stats);
+	sprintf(s_clock_status.updates, "%" PRIu32, stats.updates);
+	if (stats.updates) {
+		snprintf(s_clock_status.skew, sizeof(s_clock_status.skew),
+				"%" PRId32 " us", stats.skew_us);
+		snprintf(s_clock_status.range, sizeof(s_clock_status.range),
+				"%" PRId32 "/%" PRId32 " us", stats.skew_min_us,
+				stats.skew_max_us);
+	} else {
+		strcpy(s_clock_status.skew, "-");
+		strcpy(s_clock_status.range, "-");
+	}
+}
 
-	control_static_t static_ = {
-		.type = CONTROL_TYPE_STATIC,
-		.label = "WiFi Status:",
-		.value = s_wifi_status.status,
-	};
-	dialog_append(&dialog, &static_);
+static void clock_stats_back_action(view_t *view)
+{
+	dialog_exit();
+	dialog_redraw();
+}
+
+static void clock_stats_reset_action(view_t *view)
+{
+	clock_reset_stats();
+	dialog_redraw();
+}
+
+DIALOG_DEFINE(clock_stats_dialog,
+	CONTROL_STATIC_LIVE("Clock updates:", s_clock_status.updates,
+			clock_status_update),
+	CONTROL_STATIC_LIVE("Clock skew:", s_clock_status.skew,
+			clock_status_update),
+	CONTROL_STATIC_LIVE("Skew min/max:", s_clock_status.range,
+			clock_status_update),
+	CONTROL_BUTTON2X("Back", clock_stats_back_action, "Reset",
+			clock_stats_reset_action),
+);
+
+static void show_clock_stats_dialog(view_t *view)
+{
+	dialog_enter(&clock_stats_dialog);
+}
 
-	static_.label = "WiFi IP:";
-	static_.value = s_wifi_status.ip;
-	dialog_append(&dialog, &static_);
+static uint32_t scan_source_count(void *ctx)
+{
+	return scan_count();
+}
 
-	static_.label = "WiFi RSSI:";
-	static_.value = s_wifi_status.rssi;
-	dialog_append(&dialog, &static_);
+static const void *scan_source_get(void *ctx, uint32_t index)
+{
+	return scan_get(index, &s_scan_item) ? &s_scan_item : NULL;
+}
 
-	control_button_t button = {
-		.type = CONTROL_TYPE_BUTTON,
-		.label = "Back",
-		.action = wifi_status_back_action,
-	};
-	dialog_append(&dialog, &button);
+static void scan_source_format(void *ctx, const void *item, char *buf,
+		size_t size)
+{
+	const scan_ap_t *ap = item;
+	snprintf(buf, size, "%-14.14s %4d", ap->ssid, ap->rssi);
+}
+
+/* Cleared before the items are fetched again, so a change made meanwhile
+ * is seen on the next wake */
+static bool scan_source_changed(void *ctx)
+{
+	if (!s_scan_changed) {
+		return false;
+	}
+	s_scan_changed = false;
+	return true;
+}
+
+static const vselect_source_t scan_source = {
+	.count = scan_source_count,
+	.get = scan_source_get,
+	.format = scan_source_format,
+	.changed = scan_source_changed,
+};
 
-	dialog_enter(dialog);
+static void wifi_scan_update(void)
+{
+	s_scan_changed = true;
+	button_wake();
+}
+
+static void wifi_scan_action(view_t *view)
+{
+	s_scan_index = 0;
+	scan_start(wifi_scan_update);
+}
+
+static void wifi_network_change(view_t *view)
+{
+	scan_ap_t ap;
+
+	if (scan_get(s_scan_index, &ap)) {
+		/* A 32 character SSID fills the field, keep it terminated for
+		 * the text control */
+		strncpy((char *)s_wifi_config.sta.ssid, ap.ssid,
+				sizeof(s_wifi_config.sta.ssid) - 1);
+		s_wifi_config.sta.ssid[sizeof(s_wifi_config.sta.ssid) - 1] = '\0';
+	}
 }
 
 static void wifi_config_back_action(view_t *view)
 {
-	dialog_t *dialog = view->dialog;
+	scan_stop();
 
 	esp_wifi_disconnect();
 	esp_wifi_set_config(ESP_IF_WIFI_STA, &s_wifi_config);
@@ -139,41 +243,41 @@ static void wifi_config_back_action(view_t *view)
     strcpy(s_wifi_status.status, "Connecting");
 
 	dialog_exit();
-	dialog->free(dialog);
 	dialog_redraw();
 }
 
+DIALOG_DEFINE(wifi_config_dialog,
+	CONTROL_TEXT("WiFi SSID:", (char *)s_wifi_config.sta.ssid,
+			sizeof(s_wifi_config.sta.ssid), NULL),
+	CONTROL_TEXT("WiFi Key:", (char *)s_wifi_config.sta.password,
+			sizeof(s_wifi_config.sta.password), NULL),
+	CONTROL_VSELECT("Networks:", &scan_source, &s_scan_index,
+			wifi_network_change),
+	CONTROL_BUTTON2X("Scan", wifi_scan_action, "Back",
+			wifi_config_back_action),
+);
+
 static void show_wifi_config_dialog(view_t *view)
 {
-	dialog_t *dialog = dialog_new();
-
 	esp_wifi_get_config(ESP_IF_WIFI_STA, &s_wifi_config);
+	dialog_enter(&wifi_config_dialog);
+}
 
-	control_text_t text = {
-		.type = CONTROL_TYPE_TEXT,
-		.label = "WiFi SSID:",
-		.value = (char*)s_wifi_config.sta.ssid,
-		.size = sizeof(s_wifi_config.sta.ssid),
-	};
-	dialog_append(&dialog, &text);
-
-	text.label = "WiFi Key:";
-	text.value = (char*)s_wifi_config.sta.password;
-	text.size = sizeof(s_wifi_config.sta.password);
-	dialog_append(&dialog, &text);
-
-	control_button_t button = {
-		.type = CONTROL_TYPE_BUTTON,
-		.label = "Back",
-		.action = wifi_config_back_action,
-	};
-	dialog_append(&dialog, &button);
+static xTaskHandle menu_task_handle;
 
-	dialog_enter(dialog);
+void menu_open(void)
+{
+	lcd_save(&lcd_state);
+	show_main_dialog();
 }
 
-static xTaskHandle *main_task_handle_ptr;
-static xTaskHandle menu_task_handle;
+void menu_close(void)
+{
+	/* Nothing is left to show the results of a running scan */
+	scan_stop();
+	dialog_terminate();
+	lcd_restore(&lcd_state);
+}
 
 static void menu_task(void *pvParameters)
 {
@@ -182,17 +286,11 @@ static void menu_task(void *pvParameters)
 		vTaskDelay(50 / portTICK_PERIOD_MS);
 		if (!gpio_get_level(0)) {
 			if (dialog_active()) {
-				dialog_terminate();
-				lcd_restore(&lcd_state);
-				if (*main_task_handle_ptr) {
-					vTaskResume(*main_task_handle_ptr);
-				}
+				menu_close();
+				clock_resume();
 			} else {
-				if (*main_task_handle_ptr) {
-					vTaskSuspend(*main_task_handle_ptr);
-				}
-				lcd_save(&lcd_state);
-				show_main_dialog();
+				clock_pause();
+				menu_open();
 			}
 		}
 	}
@@ -203,13 +301,11 @@ static void gpio0_interrupt_handler(void *arg)
 	xTaskResumeFromISR(menu_task_handle);
 }
 
-void menu_init(xTaskHandle *task_handle_ptr)
+void menu_init(void)
 {
 	ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
 	ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
 
-	main_task_handle_ptr = task_handle_ptr;
-
 	gpio_config_t gpio_cfg = {
 		.intr_type = GPIO_INTR_NEGEDGE,
 		.mode = GPIO_MODE_INPUT,
@@ -223,7 +319,9 @@ void menu_init(xTaskHandle *task_handle_ptr)
 
 	esp_wifi_start();
 
-	xTaskCreate(menu_task, "menu", 384, NULL, tskIDLE_PRIORITY, &menu_task_handle);
+	/* Opening the menu draws the first dialog from this task, which takes
+	 * as much stack as drawing it from the button task */
+	xTaskCreate(menu_task, "menu", 2048, NULL, tskIDLE_PRIORITY, &menu_task_handle);
 
 	gpio_install_isr_service(0);
 	gpio_isr_handler_add(GPIO_NUM_0, gpio0_interrupt_handler, NULL);
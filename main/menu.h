@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <freertos/task.h>
 
-void menu_init(xTaskHandle *task_handle_ptr);
+void menu_init(void);
+void menu_open(void);
+void menu_close(void);
 
 #endif /* _MENU_H */
@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "scan.h"
+
+/* Results are merged after every channel, so the list fills in while the
+ * scan is still running.  It stays sorted strongest first and holds each
+ * SSID once, with the best RSSI it was seen at.  Everything below, channel
+ * included, changes under lock, so scan_stop() and scan_done() running in
+ * different tasks never see each other half way. */
+
+#define SCAN_BATCH 8
+
+static const scan_backend_t *backend;
+static scan_update_cb_t update_cb;
+static xSemaphoreHandle lock = NULL;
+static scan_ap_t *aps = NULL;
+static uint16_t ap_count = 0;
+static volatile uint8_t channel = 0; /* being scanned, 0 if idle */
+
+/* Sets the backend and returns the one it replaces.  NULL leaves scan_start()
+ * failing until a backend is set. */
+const scan_backend_t *scan_set_backend(const scan_backend_t *new_backend)
+{
+	const scan_backend_t *old;
+
+	if (!lock) {
+		lock = xSemaphoreCreateMutex();
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	old = backend;
+	backend = new_backend;
+	xSemaphoreGive(lock);
+
+	return old;
+}
+
+static void scan_merge(const scan_ap_t *ap)
+{
+	int i;
+
+	if (!ap->ssid[0]) { /* hidden */
+		return;
+	}
+
+	for (i = 0; i < ap_count; i++) {
+		if (!strcmp(aps[i].ssid, ap->ssid)) {
+			break;
+		}
+	}
+	if (i < ap_count) {
+		if (ap->rssi <= aps[i].rssi) {
+			return;
+		}
+		memmove(&aps[i], &aps[i + 1], sizeof(scan_ap_t) * (ap_count - i - 1));
+		ap_count--;
+	}
+
+	for (i = 0; i < ap_count && aps[i].rssi >= ap->rssi; i++) {
+	}
+	if (i >= CONFIG_WIFILCD_SCAN_MAX_APS) {
+		return;
+	}
+	if (ap_count == CONFIG_WIFILCD_SCAN_MAX_APS) { /* drop the weakest */
+		ap_count--;
+	}
+	memmove(&aps[i + 1], &aps[i], sizeof(scan_ap_t) * (ap_count - i));
+	aps[i] = *ap;
+	ap_count++;
+}
+
+bool scan_start(scan_update_cb_t cb)
+{
+	bool started = false;
+
+	if (!lock) { /* no backend was ever set */
+		return false;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (!aps) {
+		aps = malloc(sizeof(scan_ap_t) * CONFIG_WIFILCD_SCAN_MAX_APS);
+	}
+	if (backend && aps && !channel) {
+		ap_count = 0;
+		update_cb = cb;
+		channel = 1;
+		started = backend->start(channel);
+		if (!started) {
+			channel = 0;
+		}
+	}
+	xSemaphoreGive(lock);
+
+	/* The list was emptied */
+	if (started && cb) {
+		cb();
+	}
+	return started;
+}
+
+void scan_stop(void)
+{
+	if (!lock) {
+		return;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (channel && backend->stop) {
+		backend->stop();
+	}
+	channel = 0;
+	update_cb = NULL;
+	xSemaphoreGive(lock);
+}
+
+/* Called when the current channel finished, e.g. on WIFI_EVENT_SCAN_DONE */
+void scan_done(void)
+{
+	scan_ap_t batch[SCAN_BATCH];
+	scan_update_cb_t cb;
+	uint16_t n;
+
+	if (!lock) {
+		return;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	/* Stopped, or a late event after the last channel */
+	if (!channel) {
+		xSemaphoreGive(lock);
+		return;
+	}
+
+	do {
+		n = backend->read(batch, SCAN_BATCH);
+		for (int i = 0; i < n; i++) {
+			scan_merge(&batch[i]);
+		}
+	} while (n == SCAN_BATCH);
+
+	if (channel < SCAN_CHANNELS && backend->start(channel + 1)) {
+		channel++;
+	} else {
+		channel = 0;
+		if (backend->stop) {
+			backend->stop();
+		}
+	}
+	cb = update_cb;
+	xSemaphoreGive(lock);
+
+	if (cb) {
+		cb();
+	}
+}
+
+bool scan_running(void)
+{
+	return channel != 0;
+}
+
+uint16_t scan_count(void)
+{
+	uint16_t count;
+
+	if (!lock) {
+		return 0;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	count = ap_count;
+	xSemaphoreGive(lock);
+
+	return count;
+}
+
+bool scan_get(uint16_t index, scan_ap_t *ap)
+{
+	bool found = false;
+
+	if (!lock) {
+		return false;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (index < ap_count) {
+		*ap = aps[index];
+		found = true;
+	}
+	xSemaphoreGive(lock);
+
+	return found;
+}
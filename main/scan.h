@@ -0,0 +1,40 @@
+#ifndef _SCAN_H
+#define _SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCAN_CHANNELS 13
+
+typedef struct scan_ap_t {
+	char ssid[33];
+	int8_t rssi;
+	uint8_t channel;
+	uint8_t authmode;
+} scan_ap_t;
+
+/* Scans go one channel at a time.  start() begins scanning a channel and
+ * once scan_done() is called, read() hands out its results, returning fewer
+ * than max when they run out.  stop(), which may be NULL, aborts the channel
+ * being scanned and frees what read() holds.  It is called by scan_stop() and
+ * after the last channel. */
+typedef struct scan_backend_t {
+	bool (*start)(uint8_t channel);
+	uint16_t (*read)(scan_ap_t *aps, uint16_t max);
+	void (*stop)(void);
+} scan_backend_t;
+
+/* The ESP WiFi driver, in scan_esp.c */
+extern const scan_backend_t scan_esp_backend;
+
+typedef void (*scan_update_cb_t)(void);
+
+const scan_backend_t *scan_set_backend(const scan_backend_t *backend);
+bool scan_start(scan_update_cb_t cb);
+void scan_stop(void);
+void scan_done(void);
+bool scan_running(void);
+uint16_t scan_count(void);
+bool scan_get(uint16_t index, scan_ap_t *ap);
+
+#endif /* _SCAN_H */
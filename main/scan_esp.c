@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_wifi.h>
+
+#include "scan.h"
+
+/* Scan backend on the ESP WiFi driver.  The records of a channel are fetched
+ * on the first read() and kept until the next channel starts or the scan
+ * stops. */
+
+static wifi_ap_record_t *esp_records = NULL;
+static uint16_t esp_count;
+static uint16_t esp_pos;
+
+static void esp_free(void)
+{
+	free(esp_records);
+	esp_records = NULL;
+}
+
+static bool esp_start(uint8_t channel)
+{
+	wifi_scan_config_t config = {
+		.channel = channel,
+	};
+
+	esp_free();
+	return esp_wifi_scan_start(&config, false) == ESP_OK;
+}
+
+static uint16_t esp_read(scan_ap_t *out, uint16_t max)
+{
+	uint16_t n = 0;
+
+	if (!esp_records) {
+		esp_count = 0;
+		esp_pos = 0;
+		esp_wifi_scan_get_ap_num(&esp_count);
+		esp_records = malloc(sizeof(wifi_ap_record_t) * (esp_count + 1));
+		if (!esp_records) {
+			return 0;
+		}
+		esp_wifi_scan_get_ap_records(&esp_count, esp_records);
+	}
+
+	while (n < max && esp_pos < esp_count) {
+		wifi_ap_record_t *record = &esp_records[esp_pos++];
+		memcpy(out[n].ssid, record->ssid, sizeof(out[n].ssid) - 1);
+		out[n].ssid[sizeof(out[n].ssid) - 1] = '\0';
+		out[n].rssi = record->rssi;
+		out[n].channel = record->primary;
+		out[n].authmode = record->authmode;
+		n++;
+	}
+
+	return n;
+}
+
+static void esp_stop(void)
+{
+	esp_wifi_scan_stop();
+	esp_free();
+}
+
+const scan_backend_t scan_esp_backend = {
+	.start = esp_start,
+	.read = esp_read,
+	.stop = esp_stop,
+};
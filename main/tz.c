@@ -0,0 +1,321 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "tz.h"
+
+/* POSIX TZ rules ("CST6CDT,M3.2.0,M11.1.0"), parsed once by tz_set().
+ * tz_localtime() keeps the UTC interval between the surrounding DST
+ * transitions, so the common case is an integer offset and a civil date
+ * conversion, with no environment lookup or allocation. */
+
+typedef struct tz_rule_t {
+	char type;      /* 'M' month/week/day, 'J' julian 1-365, 'D' day 0-365 */
+	uint8_t month;
+	uint8_t week;
+	int16_t day;
+	int32_t time;   /* seconds after local midnight */
+} tz_rule_t;
+
+typedef struct tz_zone_t {
+	int32_t std_offset; /* seconds east of UTC */
+	int32_t dst_offset;
+	bool has_dst;
+	tz_rule_t start;
+	tz_rule_t end;
+} tz_zone_t;
+
+static tz_zone_t zone;
+static tz_zone_t next_zone;
+static bool zone_changed = false;
+
+/* UTC interval [cache_from, cache_until) shares one offset */
+static bool cache_valid = false;
+static time_t cache_from;
+static time_t cache_until;
+static int32_t cache_offset;
+static bool cache_isdst;
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	return a / b - (a % b < 0);
+}
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static int32_t days_from_civil(int32_t y, int32_t m, int32_t d)
+{
+	y -= m <= 2;
+	int32_t era = (y >= 0 ? y : y - 399) / 400;
+	int32_t yoe = y - era * 400;
+	int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int32_t z, int32_t *y, int32_t *m, int32_t *d)
+{
+	z += 719468;
+	int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+	int32_t doe = z - era * 146097;
+	int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int32_t mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = yoe + era * 400 + (*m <= 2);
+}
+
+static bool is_leap(int32_t y)
+{
+	return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int32_t rule_day(const tz_rule_t *rule, int32_t y)
+{
+	int32_t jan1 = days_from_civil(y, 1, 1);
+
+	if (rule->type == 'J') {
+		/* February 29th is never counted */
+		return jan1 + rule->day - 1 + (is_leap(y) && rule->day >= 60);
+	} else if (rule->type == 'D') {
+		return jan1 + rule->day;
+	}
+
+	int32_t first = days_from_civil(y, rule->month, 1);
+	int32_t next = rule->month == 12 ? days_from_civil(y + 1, 1, 1) :
+			days_from_civil(y, rule->month + 1, 1);
+	int32_t day = first + (rule->day - (first + 4) % 7 + 7) % 7 +
+			(rule->week - 1) * 7;
+	while (day >= next) { /* week 5 means the last one */
+		day -= 7;
+	}
+	return day;
+}
+
+static void tz_update(time_t t)
+{
+	struct {
+		time_t at;
+		bool isdst;
+	} changes[6];
+	int32_t y, m, d;
+	int i, n = 0;
+
+	cache_valid = true;
+	cache_isdst = false;
+	cache_offset = zone.std_offset;
+
+	if (!zone.has_dst) {
+		cache_from = INT32_MIN;
+		cache_until = INT32_MAX;
+		return;
+	}
+
+	civil_from_days(floor_div((int64_t)t + zone.std_offset, 86400), &y, &m,
+			&d);
+
+	for (int32_t year = y - 1; year <= y + 1; year++) {
+		changes[n].at = (time_t)rule_day(&zone.start, year) * 86400 +
+				zone.start.time - zone.std_offset;
+		changes[n++].isdst = true;
+		changes[n].at = (time_t)rule_day(&zone.end, year) * 86400 +
+				zone.end.time - zone.dst_offset;
+		changes[n++].isdst = false;
+	}
+
+	/* Southern zones end DST before they start it again */
+	for (i = 1; i < n; i++) {
+		for (int j = i; j > 0 && changes[j].at < changes[j - 1].at; j--) {
+			typeof(changes[0]) tmp = changes[j];
+			changes[j] = changes[j - 1];
+			changes[j - 1] = tmp;
+		}
+	}
+
+	for (i = 0; i < n - 1 && changes[i + 1].at <= t; i++) {
+	}
+
+	cache_from = changes[i].at;
+	cache_until = i + 1 < n ? changes[i + 1].at : INT32_MAX;
+	cache_isdst = changes[i].isdst;
+	cache_offset = cache_isdst ? zone.dst_offset : zone.std_offset;
+}
+
+void tz_localtime(time_t t, struct tm *tm)
+{
+	int32_t y, m, d;
+
+	portENTER_CRITICAL();
+	if (zone_changed) {
+		zone = next_zone;
+		zone_changed = false;
+		cache_valid = false;
+	}
+	portEXIT_CRITICAL();
+
+	if (!cache_valid || t < cache_from || t >= cache_until) {
+		tz_update(t);
+	}
+
+	int64_t local = (int64_t)t + cache_offset;
+	int32_t days = floor_div(local, 86400);
+	int32_t secs = local - (int64_t)days * 86400;
+
+	civil_from_days(days, &y, &m, &d);
+
+	tm->tm_year = y - 1900;
+	tm->tm_mon = m - 1;
+	tm->tm_mday = d;
+	tm->tm_hour = secs / 3600;
+	tm->tm_min = secs / 60 % 60;
+	tm->tm_sec = secs % 60;
+	tm->tm_wday = (days % 7 + 11) % 7; /* 1970-01-01 was a Thursday */
+	tm->tm_yday = days - days_from_civil(y, 1, 1);
+	tm->tm_isdst = cache_isdst;
+}
+
+static const char *parse_name(const char *s)
+{
+	const char *begin = s;
+
+	if (*s == '<') { /* quoted, e.g. <+03> */
+		s = strchr(s, '>');
+		return s ? s + 1 : NULL;
+	}
+
+	while (isalpha((unsigned char)*s)) {
+		s++;
+	}
+	return s - begin >= 3 ? s : NULL;
+}
+
+static const char *parse_number(const char *s, int32_t *value)
+{
+	if (!isdigit((unsigned char)*s)) {
+		return NULL;
+	}
+
+	*value = 0;
+	while (isdigit((unsigned char)*s)) {
+		*value = *value * 10 + (*s++ - '0');
+	}
+	return s;
+}
+
+/* [+-]hh[:mm[:ss]] */
+static const char *parse_time(const char *s, int32_t *secs)
+{
+	int32_t sign = 1, value;
+
+	if (*s == '+' || *s == '-') {
+		sign = *s++ == '-' ? -1 : 1;
+	}
+
+	if (!(s = parse_number(s, &value))) {
+		return NULL;
+	}
+	*secs = value * 3600;
+
+	for (int32_t scale = 60; *s == ':' && scale > 0; scale /= 60) {
+		if (!(s = parse_number(s + 1, &value))) {
+			return NULL;
+		}
+		*secs += value * scale;
+	}
+
+	*secs *= sign;
+	return s;
+}
+
+static const char *parse_rule(const char *s, tz_rule_t *rule)
+{
+	int32_t month, week, day;
+
+	if (*s == 'M') {
+		if (!(s = parse_number(s + 1, &month)) || *s != '.' ||
+				!(s = parse_number(s + 1, &week)) || *s != '.' ||
+				!(s = parse_number(s + 1, &day))) {
+			return NULL;
+		}
+		if (month < 1 || month > 12 || week < 1 || week > 5 || day > 6) {
+			return NULL;
+		}
+		rule->type = 'M';
+		rule->month = month;
+		rule->week = week;
+		rule->day = day;
+	} else {
+		rule->type = 'D';
+		if (*s == 'J') {
+			rule->type = 'J';
+			s++;
+		}
+		if (!(s = parse_number(s, &day)) || day > 365 ||
+				(rule->type == 'J' && day < 1)) {
+			return NULL;
+		}
+		rule->day = day;
+	}
+
+	rule->time = 2 * 3600;
+	if (*s == '/') {
+		s = parse_time(s + 1, &rule->time);
+	}
+	return s;
+}
+
+/* Parses a POSIX TZ string, returns false and keeps the current zone if it
+ * can't be understood. */
+bool tz_set(const char *spec)
+{
+	tz_zone_t tz;
+	int32_t offset;
+	const char *s = spec;
+
+	memset(&tz, 0, sizeof(tz));
+
+	/* The offsets in TZ are hours west of UTC */
+	if (!(s = parse_name(s)) || !(s = parse_time(s, &offset))) {
+		return false;
+	}
+	tz.std_offset = -offset;
+
+	if (*s) {
+		if (!(s = parse_name(s))) {
+			return false;
+		}
+		tz.has_dst = true;
+		tz.dst_offset = tz.std_offset + 3600;
+
+		if (*s && *s != ',') {
+			if (!(s = parse_time(s, &offset))) {
+				return false;
+			}
+			tz.dst_offset = -offset;
+		}
+
+		if (*s == ',') {
+			if (!(s = parse_rule(s + 1, &tz.start)) || *s != ',' ||
+					!(s = parse_rule(s + 1, &tz.end))) {
+				return false;
+			}
+		} else { /* US rules, same as newlib */
+			tz.start = (tz_rule_t) {'M', 3, 2, 0, 2 * 3600};
+			tz.end = (tz_rule_t) {'M', 11, 1, 0, 2 * 3600};
+		}
+	}
+
+	if (*s) {
+		return false;
+	}
+
+	portENTER_CRITICAL();
+	next_zone = tz;
+	zone_changed = true;
+	portEXIT_CRITICAL();
+
+	return true;
+}
@@ -0,0 +1,10 @@
+#ifndef _TZ_H
+#define _TZ_H
+
+#include <stdbool.h>
+#include <time.h>
+
+bool tz_set(const char *spec);
+void tz_localtime(time_t t, struct tm *tm);
+
+#endif /* _TZ_H */